@@ -0,0 +1,80 @@
+// Scans HeapFiles from several threads at once through a pool that is too small to hold them, so that every thread
+// keeps missing. With the default number of shards the threads read their pages without waiting on each other.
+// Usage: concurrent_scan_bench [tuples per thread] [max threads]
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::string fileName(size_t t) { return "concurrent_scan_bench" + std::to_string(t); }
+
+// Scans one file per thread and returns the elapsed time, in milliseconds
+double scan(db::Database &db, size_t threads, std::vector<long> &sums) {
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      const auto &file = db.get(fileName(t));
+      long sum = 0;
+      for (const auto &tuple : file) {
+        sum += std::get<int>(tuple.get_field(0));
+      }
+      sums[t] = sum;
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int size = argc > 1 ? std::atoi(argv[1]) : 200000;
+  size_t maxThreads = argc > 2 ? static_cast<size_t>(std::atoi(argv[2]))
+                               : std::max<size_t>(4, std::thread::hardware_concurrency());
+  db::DatabaseOptions options;
+  options.buffer_pool.num_pages = 1024;
+  db::Database &db = db::initDatabase(options);
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  for (size_t t = 0; t < maxThreads; t++) {
+    std::string name = fileName(t);
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+    auto &file = db.get(name);
+    for (int i = 0; i < size; ++i) {
+      file.insertTuple({{i, "name" + std::to_string(i), (i % 1000) * 0.1}});
+    }
+    db.getBufferPool().flushFile(name);
+  }
+
+  std::printf("%d tuples per thread, %zu pages in %zu shards\n", size, db.getBufferPool().capacity(),
+              db.getBufferPool().getNumShards());
+  long expected = static_cast<long>(size) * (size - 1) / 2;
+  double single = 0;
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    std::vector<long> sums(threads);
+    double elapsed = scan(db, threads, sums);
+    if (threads == 1) {
+      single = elapsed;
+    }
+    bool correct = std::all_of(sums.begin(), sums.end(), [&](long sum) { return sum == expected; });
+    std::printf("%2zu threads: %8.2f ms, %7.1f Mtuples/s (%.1fx)%s\n", threads, elapsed,
+                static_cast<double>(threads) * size / elapsed / 1000, single * static_cast<double>(threads) / elapsed,
+                correct ? "" : " MISMATCH");
+  }
+  for (size_t t = 0; t < maxThreads; t++) {
+    std::string name = fileName(t);
+    db.remove(name);
+    std::remove(name.c_str());
+    std::remove((name + ".fsm").c_str());
+    std::remove((name + ".layout").c_str());
+  }
+}
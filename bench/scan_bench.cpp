@@ -0,0 +1,85 @@
+// Compares filtering a HeapFile through the tuple iterator with scans that push the predicate into the pages.
+// Usage: scan_bench [tuples]
+#include <db/Chunk.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Predicate.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+namespace {
+// Runs f a few times and returns the fastest run, in milliseconds
+double measure(const std::function<size_t()> &f, size_t &result) {
+  double best = 0;
+  for (int run = 0; run < 5; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    result = f();
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    best = run == 0 ? elapsed : std::min(best, elapsed);
+  }
+  return best;
+}
+
+// The current path: every tuple is deserialized and its fields compared as variants
+size_t iterate(const db::DbFile &file, int maxId, double minPrice) {
+  size_t count = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    db::Tuple t = *it;
+    if (std::get<int>(t.get_field(0)) < maxId && std::get<double>(t.get_field(2)) >= minPrice) {
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t scan(const db::DbFile &file, const db::Predicate &predicate) {
+  db::Chunk chunk(file.getTupleDesc());
+  auto cursor = file.begin();
+  size_t count = 0;
+  while (file.scan(cursor, chunk, &predicate)) {
+    count += chunk.selection().size();
+  }
+  return count;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int size = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  db::DatabaseOptions options;
+  options.buffer_pool.num_pages = static_cast<size_t>(size) / 53 * 2 + 64;
+  db::Database &db = db::initDatabase(options);
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+
+  std::printf("%d tuples (INT, CHAR, DOUBLE)\n", size);
+  for (auto layout : {db::page_layout_t::ROW, db::page_layout_t::PAX}) {
+    std::string name = layout == db::page_layout_t::ROW ? "scan_bench_row" : "scan_bench_pax";
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED,
+                                          db::DEFAULT_EXTENT_PAGES, layout));
+    auto &file = db.get(name);
+    for (int i = 0; i < size; ++i) {
+      file.insertTuple({{i, "name" + std::to_string(i), (i % 1000) * 0.1}});
+    }
+
+    for (double selectivity : {0.01, 0.5}) {
+      int maxId = static_cast<int>(size * selectivity);
+      db::Predicate predicate = db::Predicate(0, db::op_t::LT, maxId) && db::Predicate(2, db::op_t::GE, 0.0);
+      size_t expected;
+      size_t actual;
+      double iterated = measure([&] { return iterate(file, maxId, 0.0); }, expected);
+      double scanned = measure([&] { return scan(file, predicate); }, actual);
+      std::printf("%s, %4.0f%% selected: iterator %8.2f ms, pushdown scan %7.2f ms (%.1fx)%s\n",
+                  layout == db::page_layout_t::ROW ? "ROW" : "PAX", selectivity * 100, iterated, scanned,
+                  iterated / scanned, expected == actual ? "" : " MISMATCH");
+    }
+    db.remove(name);
+    std::remove(name.c_str());
+    std::remove((name + ".fsm").c_str());
+    std::remove((name + ".layout").c_str());
+  }
+}
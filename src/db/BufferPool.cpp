@@ -1,93 +1,856 @@
 #include <db/BufferPool.hpp>
 #include <db/Database.hpp>
+#include <algorithm>
+#include <cmath>
 #include <numeric>
+#include <stdexcept>
 
 using namespace db;
 
-BufferPool::BufferPool() : available(DEFAULT_NUM_PAGES) { std::iota(available.rbegin(), available.rend(), 0); }
+BufferPool::BufferPool(const BufferPoolOptions &options)
+    : pages(options.num_pages, options.huge_pages), latches(std::make_unique<std::shared_mutex[]>(options.num_pages)),
+      metas(std::make_unique<std::atomic<uint64_t>[]>(options.num_pages)), frames(options.num_pages),
+      num_shards(options.num_shards), readahead(options.readahead),
+      scan_run(options.scan_run), clean_fraction(options.clean_fraction) {
+  if (options.num_pages == 0 || options.num_shards > options.num_pages) {
+    throw std::logic_error("BufferPool must have at least one page per shard");
+  }
+  if (clean_fraction < 0 || clean_fraction > 1) {
+    throw std::logic_error("The clean fraction must be between 0 and 1");
+  }
+  if (num_shards == 0) {
+    // One shard per hardware thread, each with enough frames to hold the pages pinned by a few scans
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    num_shards = std::clamp<size_t>(options.num_pages / MIN_SHARD_PAGES, 1, threads);
+  }
+  // Split the frames evenly, the first shards get one extra frame each when the split is not exact
+  shards = std::make_unique<Shard[]>(num_shards);
+  size_t first = 0;
+  for (size_t i = 0; i < num_shards; i++) {
+    Shard &shard = shards[i];
+    size_t size = options.num_pages / num_shards + (i < options.num_pages % num_shards ? 1 : 0);
+    shard.first = first;
+    shard.size = size;
+    shard.available.resize(size);
+    std::iota(shard.available.rbegin(), shard.available.rend(), first);
+    shard.pid_to_pos = FrameTable(size);
+    shard.policy = makeReplacementPolicy(options.policy, size);
+    shard.ring_size = options.ring_size == 0 ? 0 : std::max<size_t>(1, options.ring_size / num_shards);
+    first += size;
+  }
+  if (readahead > 0) {
+    prefetcher = std::thread(&BufferPool::prefetchLoop, this);
+  }
+  if (clean_fraction > 0) {
+    writer = std::thread(&BufferPool::writerLoop, this);
+  }
+}
 
 BufferPool::~BufferPool() {
-  for (const size_t &pos : dirty) {
-    const Page &page = pages[pos];
-    const PageId &pid = pos_to_pid[pos];
-    getDatabase().get(pid.file).writePage(page, pid.page);
+  if (writer.joinable()) {
+    {
+      std::lock_guard lock(writer_mutex);
+      writer_stopping = true;
+    }
+    writer_cv.notify_one();
+    writer.join();
+  }
+  if (prefetcher.joinable()) {
+    {
+      std::lock_guard lock(readahead_mutex);
+      stopping = true;
+    }
+    prefetch_cv.notify_one();
+    prefetcher.join();
+  }
+  writeBack([](const PageId &) { return true; });
+}
+
+size_t BufferPool::capacity() const { return pages.size(); }
+
+BufferPoolStats BufferPool::getStats() const {
+  return {hits.load(),         misses.load(),          prefetches.load(),
+          prefetch_hits.load(), prefetch_unused.load(), background_writes.load()};
+}
+
+BufferPool::Shard &BufferPool::shardOf(const PageId &pid) const {
+  return shards[std::hash<PageId>()(pid) % num_shards];
+}
+
+Page &BufferPool::getPage(const PageId &pid, access_t access) {
+  // The page is pinned while it is looked up, so that a page another thread is reading is only returned once it is read
+  size_t pos = pin(pid, access);
+  unpin(pid, pos, false);
+  return pages[pos];
+}
+
+ReadPageGuard BufferPool::fetchRead(const PageId &pid, access_t access) {
+  // The latch is taken after the shard lock is released: the pin already keeps the frame from being evicted
+  size_t pos = pin(pid, access);
+  return {this, pid, pos, &pages[pos], latches[pos]};
+}
+
+WritePageGuard BufferPool::fetchWrite(const PageId &pid, access_t access) {
+  size_t pos = pin(pid, access);
+  return {this, pid, pos, &pages[pos], latches[pos]};
+}
+
+PinnedPage BufferPool::fetchPinned(const PageId &pid, access_t access) {
+  size_t pos = pin(pid, access);
+  return {this, pid, pos, &pages[pos]};
+}
+
+WritePageGuard BufferPool::newPage(const PageId &pid) {
+  Shard &shard = shardOf(pid);
+  size_t pos;
+  {
+    std::unique_lock lock(shard.mutex);
+    do {
+      if (shard.pid_to_pos.contains(pid)) {
+        throw std::logic_error("Page is already in the BufferPool");
+      }
+      pos = freeFrame(shard, lock);
+    } while (pos == FrameTable::npos);
+    // The frame needs no latch while it is filled: until it is tracked, no one can find it
+    pages[pos].fill(0);
+    track(shard, pos, pid, false);
+    setDirty(shard, pos, true);
+    frames[pos].pins++;
+  }
+  return {this, pid, pos, &pages[pos], latches[pos]};
+}
+
+size_t BufferPool::pin(const PageId &pid, access_t access) {
+  size_t pos;
+  {
+    Shard &shard = shardOf(pid);
+    std::unique_lock lock(shard.mutex);
+    pos = fetch(shard, lock, pid, access);
+  }
+  scheduleReadAhead(pid, access);
+  return pos;
+}
+
+void BufferPool::repin(const PageId &pid, size_t pos) {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  frames[pos].pins++;
+}
+
+void BufferPool::unpin(const PageId &pid, size_t pos, bool dirty) {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  if (dirty) {
+    setDirty(shard, pos, true);
+  }
+  release(shard, pos);
+}
+
+void BufferPool::release(Shard &shard, size_t pos) {
+  // The frame of a page that failed to load returns to the shard once the threads that waited for it are gone
+  if (--frames[pos].pins == 0 && frames[pos].pid.file == INVALID_FILE_ID) {
+    shard.available.push_back(pos);
+  }
+}
+
+bool BufferPool::isPinned(const PageId &pid) const {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = shard.pid_to_pos.find(pid);
+  return pos != FrameTable::npos && frames[pos].pins > 0;
+}
+
+size_t BufferPool::resident(const Shard &shard, const PageId &pid) const {
+  size_t pos = shard.pid_to_pos.find(pid);
+  if (pos == FrameTable::npos) {
+    throw std::out_of_range("Page is not in the BufferPool");
+  }
+  return pos;
+}
+
+size_t BufferPool::fetch(Shard &shard, std::unique_lock<std::mutex> &lock, const PageId &pid, access_t access) {
+  bool missed = false;
+  bool batched = false;
+  while (true) {
+    // If already in buffer pool, report the hit and return it. Hits of a scan do not make a page hot
+    if (size_t pos = shard.pid_to_pos.find(pid); pos != FrameTable::npos) {
+      hits += missed ? 0 : 1;
+      if (access == access_t::NORMAL) {
+        shard.policy->access(pos - shard.first);
+      }
+      if (frames[pos].prefetched) {
+        // The read-ahead was useful: widen the window of the file
+        frames[pos].prefetched = false;
+        prefetch_hits++;
+        std::lock_guard readahead_lock(readahead_mutex);
+        ReadAhead &state = readaheads[pid.file];
+        state.window = std::min(readahead, std::max(state.window * 2, INITIAL_READAHEAD));
+      }
+      frames[pos].pins++;
+      if (!frames[pos].loading) {
+        return pos;
+      }
+      // Another thread is reading the page and holds its latch: wait for it without the shard lock
+      lock.unlock();
+      latches[pos].lock_shared();
+      latches[pos].unlock_shared();
+      lock.lock();
+      if (frames[pos].pid == pid) {
+        return pos;
+      }
+      // The read failed, try it again
+      release(shard, pos);
+      continue;
+    }
+    if (!missed) {
+      misses++;
+      missed = true;
+    }
+
+    if (!batched && access == access_t::SEQUENTIAL && readahead == 0 && scan_run > 1) {
+      // Fault in the missing pages of the shard among the next ones of the scan, each contiguous run with one read
+      batched = true;
+      size_t numPages = getDatabase().get(pid.file).getNumPages();
+      std::vector<std::pair<PageId, access_t>> batch;
+      for (size_t page = pid.page; page < std::min<size_t>(pid.page + scan_run, numPages); page++) {
+        if (PageId next{pid.file, page}; &shardOf(next) == &shard) {
+          batch.emplace_back(next, access);
+        }
+      }
+      if (batch.size() > 1) {
+        loadBatch(shard, lock, batch, false);
+        continue;
+      }
+    }
+
+    // Scans recycle the frames of their ring, other accesses get a free frame or evict the policy's victim
+    bool ring = access == access_t::SEQUENTIAL && shard.ring_size > 0;
+    size_t pos = ring ? ringFrame(shard, lock, pid.file) : freeFrame(shard, lock);
+    if (pos == FrameTable::npos) {
+      // The shard lock was released to write a victim: another thread may have loaded the page since
+      continue;
+    }
+    // Read the page without the shard lock: the requests for it wait on its latch
+    reserve(shard, pos, pid, ring, false);
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      getDatabase().get(pid.file).readPage(pages[pos], pid.page);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    finishLoad(shard, pos, !error);
+    if (error) {
+      release(shard, pos);
+      std::rethrow_exception(error);
+    }
+    return pos;
+  }
+}
+
+void BufferPool::reserve(Shard &shard, size_t pos, const PageId &pid, bool ring, bool prefetching) {
+  // The frame is free: its latch is not held
+  latches[pos].lock();
+  track(shard, pos, pid, ring);
+  frames[pos].loading = true;
+  frames[pos].prefetched = prefetching;
+  frames[pos].pins++;
+}
+
+void BufferPool::finishLoad(Shard &shard, size_t pos, bool read) {
+  frames[pos].loading = false;
+  if (!read) {
+    // Stop tracking the page, the frame is given back once it is unpinned
+    shard.pid_to_pos.erase(frames[pos].pid);
+    shard.policy->remove(pos - shard.first);
+    frames[pos].pid = {};
+    frames[pos].ring_tag = 0;
+    frames[pos].prefetched = false;
+  }
+  latches[pos].unlock();
+}
+
+void BufferPool::track(Shard &shard, size_t pos, const PageId &pid, bool ring) {
+  shard.pid_to_pos.insert(pid, pos);
+  frames[pos].pid = pid;
+  metas[pos].store(0, std::memory_order_relaxed);
+  shard.policy->insert(pos - shard.first, pid);
+
+  if (ring) {
+    frames[pos].ring_tag = ++shard.next_ring_tag;
+    shard.rings[pid.file][std::this_thread::get_id()].emplace_back(pos, frames[pos].ring_tag);
+  }
+}
+
+void BufferPool::scheduleReadAhead(const PageId &pid, access_t access) {
+  if (readahead == 0) {
+    return;
+  }
+  size_t numPages = getDatabase().get(pid.file).getNumPages();
+  std::lock_guard lock(readahead_mutex);
+  ReadAhead &state = readaheads[pid.file];
+  if (pid.page == state.last) {
+    return;
+  }
+  // Any jump resets the window, a request for the page that follows the last one extends the scheduled run
+  bool sequential = pid.page == state.last + 1;
+  state.last = pid.page;
+  if (!sequential) {
+    state.next = pid.page + 1;
+    state.window = 0;
+    return;
+  }
+  if (state.window == 0) {
+    state.window = std::min(INITIAL_READAHEAD, readahead);
+  }
+  size_t first = std::max<size_t>(state.next, pid.page + 1);
+  size_t last = std::min(pid.page + 1 + state.window, numPages);
+  for (size_t page = first; page < last; page++) {
+    prefetch_queue.emplace_back(PageId{pid.file, page}, access);
+  }
+  if (first < last) {
+    state.next = last;
+    prefetch_cv.notify_one();
+  }
+}
+
+void BufferPool::prefetchLoop() {
+  std::vector<std::pair<PageId, access_t>> batch;
+  std::unique_lock lock(readahead_mutex);
+  while (true) {
+    prefetch_cv.wait(lock, [&] { return stopping || !prefetch_queue.empty(); });
+    if (stopping) {
+      return;
+    }
+    // Take up to a full window of pages so that their reads are in flight together
+    size_t count = std::min(prefetch_queue.size(), readahead);
+    batch.assign(prefetch_queue.begin(), prefetch_queue.begin() + static_cast<std::ptrdiff_t>(count));
+    prefetch_queue.erase(prefetch_queue.begin(), prefetch_queue.begin() + static_cast<std::ptrdiff_t>(count));
+    lock.unlock();
+    prefetch(batch);
+    lock.lock();
+  }
+}
+
+void BufferPool::prefetch(std::vector<std::pair<PageId, access_t>> &batch) {
+  // Each shard reserves the frames of its part of the batch under its lock and reads them without it
+  std::vector<std::pair<PageId, access_t>> part;
+  for (size_t i = 0; i < num_shards; i++) {
+    part.clear();
+    for (const auto &entry : batch) {
+      if (&shardOf(entry.first) == &shards[i]) {
+        part.push_back(entry);
+      }
+    }
+    if (!part.empty()) {
+      std::unique_lock lock(shards[i].mutex);
+      loadBatch(shards[i], lock, part, true);
+    }
+  }
+}
+
+void BufferPool::loadBatch(Shard &shard, std::unique_lock<std::mutex> &lock,
+                           const std::vector<std::pair<PageId, access_t>> &batch, bool prefetching) {
+  struct Load {
+    PageId pid;
+    size_t pos;
+    bool read;
+  };
+
+  // Reserve a frame for every page that is not resident yet. A batch takes at most a ring of frames, since its pages
+  // would recycle each other's frames, or a quarter of the shard, so that it cannot push out all the hot pages.
+  // The reserved pages are tracked right away, so the requests for them wait for the batch
+  std::vector<Load> loading;
+  for (size_t b = 0; b < batch.size();) {
+    const auto &[pid, access] = batch[b];
+    if (shard.pid_to_pos.contains(pid)) {
+      b++;
+      continue;
+    }
+    bool ring = access == access_t::SEQUENTIAL && shard.ring_size > 0;
+    if (loading.size() == (ring ? shard.ring_size : std::max<size_t>(1, shard.size / 4))) {
+      break;
+    }
+    size_t pos;
+    try {
+      pos = ring ? ringFrame(shard, lock, pid.file) : freeFrame(shard, lock);
+    } catch (const std::exception &) {
+      // Read-ahead is only a hint: give up when every frame is pinned
+      break;
+    }
+    if (pos == FrameTable::npos) {
+      // The shard lock was released to write a victim: check the page again
+      continue;
+    }
+    reserve(shard, pos, pid, ring, prefetching);
+    loading.push_back({pid, pos, false});
+    b++;
+  }
+  if (loading.empty()) {
+    return;
+  }
+
+  // Read each run of contiguous pages with one request and submit all the requests at once
+  std::sort(loading.begin(), loading.end(), [](const Load &a, const Load &b) { return a.pid.key() < b.pid.key(); });
+  std::vector<iovec> iov(loading.size());
+  std::vector<IoRequest> requests;
+  std::vector<size_t> starts; // position in loading of the first page of each request
+  for (size_t begin = 0; begin < loading.size();) {
+    const PageId &pid = loading[begin].pid;
+    size_t end = begin + 1;
+    while (end < loading.size() && loading[end].pid.file == pid.file &&
+           loading[end].pid.page == pid.page + (end - begin)) {
+      end++;
+    }
+    for (size_t i = begin; i < end; i++) {
+      iov[i] = {pages[loading[i].pos].data(), DEFAULT_PAGE_SIZE};
+    }
+    try {
+      requests.push_back(getDatabase().get(pid.file).request(false, pid.page, &iov[begin], end - begin));
+      starts.push_back(begin);
+    } catch (const std::exception &) {
+      // The file is gone or has shrunk
+    }
+    begin = end;
+  }
+  lock.unlock();
+  try {
+    getDatabase().getIoBackend().submit(requests);
+  } catch (const std::exception &) {
+    for (IoRequest &request : requests) {
+      request.result = -EIO;
+    }
+  }
+  lock.lock();
+
+  // Keep the pages that were read, give back the frames of the others
+  for (size_t r = 0; r < requests.size(); r++) {
+    bool read = requests[r].result >= 0 && static_cast<size_t>(requests[r].result) == requests[r].length();
+    for (size_t i = starts[r]; i < starts[r] + requests[r].iovcnt; i++) {
+      loading[i].read = read;
+    }
+  }
+  for (const Load &load : loading) {
+    finishLoad(shard, load.pos, load.read);
+    if (load.read && prefetching) {
+      prefetches++;
+    }
+    release(shard, load.pos);
+  }
+}
+
+size_t BufferPool::freeFrame(Shard &shard, std::unique_lock<std::mutex> &lock) {
+  // If there are no available pages, evict the victim of the replacement policy. With a background writer, prefer
+  // a clean victim so that the eviction does not wait for a write
+  if (shard.available.empty()) {
+    size_t pos = FrameTable::npos;
+    if (clean_fraction > 0 && shard.num_dirty < shard.size) {
+      try {
+        pos = shard.first + shard.policy->victim([&](size_t pos) {
+          const Frame &frame = frames[shard.first + pos];
+          return frame.pins == 0 && !frame.dirty;
+        });
+      } catch (const std::runtime_error &) {
+        // every clean frame is pinned
+      }
+    }
+    if (pos == FrameTable::npos) {
+      pos = shard.first + shard.policy->victim([&](size_t pos) { return frames[shard.first + pos].pins == 0; });
+      if (frames[pos].dirty) {
+        writeVictim(shard, lock, pos);
+        return FrameTable::npos;
+      }
+    }
+    evict(shard, pos);
   }
+  size_t pos = shard.available.back();
+  shard.available.pop_back();
+  return pos;
 }
 
-Page &BufferPool::getPage(const PageId &pid) {
-  // If already in buffer pool, make it the most recent page and return it
-  if (contains(pid)) {
-    size_t pos = pid_to_pos.at(pid);
-    lru_list.splice(lru_list.begin(), lru_list, pos_to_lru[pos]);
-    pos_to_lru[pos] = lru_list.begin();
-    return pages[pos];
+void BufferPool::writeVictim(Shard &shard, std::unique_lock<std::mutex> &lock, size_t pos) {
+  if (clean_fraction > 0) {
+    writer_cv.notify_one();
+  }
+  // The victim is written without the shard lock, pinned so that it stays in its frame. The caller then picks a
+  // victim again: the page is clean unless it was changed in the meantime
+  std::vector<size_t> claimed;
+  if (claim(shard, pos)) {
+    claimed.push_back(pos);
+  }
+  lock.unlock();
+  try {
+    writeClaimed(claimed);
+  } catch (...) {
+    lock.lock();
+    throw;
   }
+  lock.lock();
+}
 
-  // If there are no available pages, evict the least recently used page. If the page is dirty, flush it to disk
-  if (available.empty()) {
-    size_t pos = lru_list.back();
-    const PageId &old_pid = pos_to_pid.at(pos);
-    if (isDirty(old_pid)) {
-      flushPage(old_pid);
+size_t BufferPool::ringFrame(Shard &shard, std::unique_lock<std::mutex> &lock, file_id_t file) {
+  auto &ring = shard.rings[file][std::this_thread::get_id()];
+  while (ring.size() >= shard.ring_size) {
+    auto [pos, tag] = ring.front();
+    // Entries of frames that have been evicted (and possibly reused) since they joined the ring are stale.
+    // A pinned frame leaves the ring and is evicted later by the replacement policy
+    if (frames[pos].ring_tag == tag && frames[pos].pins == 0) {
+      if (frames[pos].dirty) {
+        // The entry stays at the front of the ring until the page is clean
+        writeVictim(shard, lock, pos);
+        return FrameTable::npos;
+      }
+      evict(shard, pos);
     }
-    discardPage(old_pid);
+    ring.pop_front();
   }
+  return freeFrame(shard, lock);
+}
 
-  // Read the page from disk to one of the available slots, make it the most recent page
-  size_t pos = available.back();
-  available.pop_back();
+void BufferPool::evict(Shard &shard, size_t pos) {
+  // The victim is clean and unpinned: no one holds its latch
+  std::unique_lock latch(latches[pos]);
+  discardFrame(shard, pos);
+}
 
-  Page &page = pages[pos];
-  getDatabase().get(pid.file).readPage(page, pid.page);
-  pid_to_pos[pid] = pos;
-  pos_to_pid[pos] = pid;
+void BufferPool::discardFrame(Shard &shard, size_t pos) {
+  if (frames[pos].prefetched) {
+    // The read-ahead went too far: narrow the window of the file
+    frames[pos].prefetched = false;
+    prefetch_unused++;
+    std::lock_guard lock(readahead_mutex);
+    ReadAhead &state = readaheads[frames[pos].pid.file];
+    state.window = std::max<size_t>(1, state.window / 2);
+  }
+  shard.pid_to_pos.erase(frames[pos].pid);
+  frames[pos].pid = {};
+  metas[pos].store(0, std::memory_order_relaxed);
 
-  lru_list.push_front(pos);
-  pos_to_lru[pos] = lru_list.begin();
+  shard.policy->remove(pos - shard.first);
+  frames[pos].ring_tag = 0;
+  setDirty(shard, pos, false);
+  shard.available.push_back(pos);
+}
 
-  return page;
+void BufferPool::setDirty(Shard &shard, size_t pos, bool dirty) {
+  if (frames[pos].dirty != dirty) {
+    frames[pos].dirty = dirty;
+    if (dirty) {
+      shard.num_dirty++;
+    } else {
+      shard.num_dirty--;
+    }
+  }
 }
 
 void BufferPool::markDirty(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  dirty.insert(pos);
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = resident(shard, pid);
+  setDirty(shard, pos, true);
+  metas[pos].store(0, std::memory_order_relaxed);
 }
 
 bool BufferPool::isDirty(const PageId &pid) const {
-  size_t pos = pid_to_pos.at(pid);
-  return dirty.contains(pos);
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = resident(shard, pid);
+  return frames[pos].dirty;
 }
 
-bool BufferPool::contains(const PageId &pid) const { return pid_to_pos.contains(pid); }
+bool BufferPool::contains(const PageId &pid) const {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  return shard.pid_to_pos.contains(pid);
+}
 
 void BufferPool::discardPage(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  pid_to_pos.erase(pid);
-  pos_to_pid[pos] = {};
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = resident(shard, pid);
+  if (frames[pos].pins > 0) {
+    throw std::logic_error("Cannot discard a pinned page");
+  }
+  std::unique_lock latch(latches[pos]);
+  discardFrame(shard, pos);
+}
 
-  lru_list.erase(pos_to_lru[pos]);
-  pos_to_lru.erase(pos);
-  dirty.erase(pos);
-  available.push_back(pos);
+void BufferPool::discardFile(file_id_t file) {
+  bool all = true;
+  for (size_t i = 0; i < num_shards; i++) {
+    Shard &shard = shards[i];
+    std::lock_guard lock(shard.mutex);
+    for (size_t pos = shard.first; pos < shard.first + shard.size; pos++) {
+      if (frames[pos].pid.file != file) {
+        continue;
+      }
+      if (frames[pos].pins > 0 || frames[pos].dirty) {
+        all = false;
+        continue;
+      }
+      std::unique_lock latch(latches[pos]);
+      discardFrame(shard, pos);
+    }
+    // The entries of frames that were kept are dropped as well: the policy evicts those frames
+    shard.rings.erase(file);
+  }
+  if (!all) {
+    throw std::logic_error("Cannot discard the pinned or dirty pages of a file");
+  }
 }
 
-void BufferPool::flushPage(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  if (dirty.erase(pos) == 0)
-    return;
-  const Page &page = pages[pos];
-  getDatabase().get(pid.file).writePage(page, pid.page);
+bool BufferPool::flushPage(const PageId &pid) {
+  std::vector<size_t> claimed;
+  {
+    Shard &shard = shardOf(pid);
+    std::lock_guard lock(shard.mutex);
+    size_t pos = resident(shard, pid);
+    if (!frames[pos].dirty) {
+      return true;
+    }
+    // A page latched for writing is skipped, the write happens without the shard lock
+    if (!claim(shard, pos)) {
+      return false;
+    }
+    claimed.push_back(pos);
+  }
+  writeClaimed(claimed);
+  return true;
+}
+
+bool BufferPool::flushFile(file_id_t file) {
+  DbFile &dbFile = getDatabase().get(file);
+  uint64_t epoch = dbFile.getWriteEpoch();
+  if (!writeBack([&](const PageId &pid) { return pid.file == file; })) {
+    return false;
+  }
+  dbFile.remap(epoch);
+  return true;
+}
+
+bool BufferPool::flushFile(const std::string &file) { return flushFile(getDatabase().get(file).getId()); }
+
+bool BufferPool::claim(Shard &shard, size_t pos) {
+  // The shared latch keeps writers out while the page is written, the pin keeps the frame from being evicted
+  if (!latches[pos].try_lock_shared()) {
+    return false;
+  }
+  setDirty(shard, pos, false);
+  frames[pos].pins++;
+  return true;
+}
+
+void BufferPool::writeClaimed(std::vector<size_t> &claimed, bool background) {
+  // PageId::key() orders pages by file, then by page number
+  std::sort(claimed.begin(), claimed.end(),
+            [&](size_t a, size_t b) { return frames[a].pid.key() < frames[b].pid.key(); });
+
+  std::exception_ptr error;
+  auto fail = [&] {
+    if (!error) {
+      error = std::current_exception();
+    }
+  };
+  // Release the frames of claimed[begin, end), the pages of a failed write become dirty again
+  auto release = [&](size_t begin, size_t end, bool written) {
+    for (size_t i = begin; i < end; i++) {
+      size_t pos = claimed[i];
+      latches[pos].unlock_shared();
+      Shard &shard = shardOf(frames[pos].pid);
+      std::lock_guard lock(shard.mutex);
+      if (!written) {
+        setDirty(shard, pos, true);
+      }
+      frames[pos].pins--;
+    }
+  };
+
+  // Describe each run of contiguous pages of the same file with one request
+  std::vector<iovec> iov(claimed.size());
+  std::vector<IoRequest> requests;
+  std::vector<std::pair<size_t, size_t>> runs; // [begin, end) in claimed of each request
+  for (size_t begin = 0; begin < claimed.size();) {
+    const PageId &pid = frames[claimed[begin]].pid;
+    size_t end = begin + 1;
+    while (end < claimed.size() && frames[claimed[end]].pid.file == pid.file &&
+           frames[claimed[end]].pid.page == pid.page + (end - begin)) {
+      end++;
+    }
+    for (size_t i = begin; i < end; i++) {
+      iov[i] = {pages[claimed[i]].data(), DEFAULT_PAGE_SIZE};
+    }
+    try {
+      requests.push_back(getDatabase().get(pid.file).request(true, pid.page, &iov[begin], end - begin));
+      runs.emplace_back(begin, end);
+    } catch (...) {
+      fail();
+      release(begin, end, false);
+    }
+    begin = end;
+  }
+
+  // Keep every write in flight at once
+  try {
+    getDatabase().getIoBackend().submit(requests);
+  } catch (...) {
+    fail();
+    for (IoRequest &request : requests) {
+      request.result = -EIO;
+    }
+  }
+  for (size_t r = 0; r < requests.size(); r++) {
+    bool written = false;
+    try {
+      getDatabase().get(frames[claimed[runs[r].first]].pid.file).complete(requests[r]);
+      written = true;
+      if (background) {
+        background_writes += runs[r].second - runs[r].first;
+      }
+    } catch (...) {
+      fail();
+    }
+    release(runs[r].first, runs[r].second, written);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool BufferPool::writeBack(const std::function<bool(const PageId &)> &select) {
+  std::vector<size_t> claimed;
+  bool all = true;
+  for (size_t i = 0; i < num_shards; i++) {
+    Shard &shard = shards[i];
+    std::lock_guard lock(shard.mutex);
+    for (size_t pos = shard.first; pos < shard.first + shard.size; pos++) {
+      if (frames[pos].dirty && select(frames[pos].pid)) {
+        if (claim(shard, pos)) {
+          claimed.push_back(pos);
+        } else {
+          all = false;
+        }
+      }
+    }
+  }
+  writeClaimed(claimed);
+  return all;
+}
+
+void BufferPool::writerLoop() {
+  std::unique_lock lock(writer_mutex);
+  while (!writer_stopping) {
+    writer_cv.wait_for(lock, WRITER_INTERVAL);
+    if (writer_stopping) {
+      break;
+    }
+    lock.unlock();
+    for (size_t i = 0; i < num_shards; i++) {
+      try {
+        cleanShard(shards[i]);
+      } catch (const std::exception &) {
+        // The pages stay dirty and are retried on the next round
+      }
+    }
+    lock.lock();
+  }
 }
 
-void BufferPool::flushFile(const std::string &file) {
-  std::vector<size_t> to_flush;
-  for (const size_t &pos : dirty) {
-    const PageId &pid = pos_to_pid[pos];
-    if (pid.file == file) {
-      to_flush.emplace_back(pid.page);
+void BufferPool::cleanShard(Shard &shard) {
+  std::vector<size_t> claimed;
+  {
+    std::lock_guard lock(shard.mutex);
+    size_t target = static_cast<size_t>(std::ceil(clean_fraction * static_cast<double>(shard.size)));
+    size_t clean = shard.size - shard.num_dirty;
+    for (size_t pos = shard.first; pos < shard.first + shard.size && clean + claimed.size() < target; pos++) {
+      if (frames[pos].dirty && frames[pos].pins == 0 && claim(shard, pos)) {
+        claimed.push_back(pos);
+      }
     }
   }
-  for (const auto &page : to_flush) {
-    flushPage({file, page});
+  writeClaimed(claimed, true);
+}
+
+PageGuard::PageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page)
+    : pool(pool), pid(pid), pos(pos), page(page) {}
+
+PageGuard::PageGuard(PageGuard &&other) noexcept
+    : pool(std::exchange(other.pool, nullptr)), pid(other.pid), pos(other.pos), page(other.page) {}
+
+PageGuard &PageGuard::operator=(PageGuard &&other) noexcept {
+  if (this != &other) {
+    unpin(false);
+    pool = std::exchange(other.pool, nullptr);
+    pid = other.pid;
+    pos = other.pos;
+    page = other.page;
+  }
+  return *this;
+}
+
+PageGuard::~PageGuard() { unpin(false); }
+
+uint64_t PageGuard::getMeta() const { return pool->metas[pos].load(std::memory_order_relaxed); }
+
+void PageGuard::setMeta(uint64_t meta) const { pool->metas[pos].store(meta, std::memory_order_relaxed); }
+
+void PageGuard::unpin(bool dirty) {
+  if (pool != nullptr) {
+    std::exchange(pool, nullptr)->unpin(pid, pos, dirty);
+  }
+}
+
+PinnedPage::PinnedPage(const PinnedPage &other) : PageGuard(other.pool, other.pid, other.pos, other.page) {
+  if (pool != nullptr) {
+    pool->repin(pid, pos);
+  }
+}
+
+PinnedPage &PinnedPage::operator=(const PinnedPage &other) {
+  if (this != &other) {
+    *this = PinnedPage(other);
+  }
+  return *this;
+}
+
+ReadPageGuard::ReadPageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page, std::shared_mutex &latch)
+    : PageGuard(pool, pid, pos, page), latch(latch) {}
+
+ReadPageGuard &ReadPageGuard::operator=(ReadPageGuard &&other) noexcept {
+  if (this != &other) {
+    release();
+    latch = std::move(other.latch);
+    PageGuard::operator=(std::move(other));
+  }
+  return *this;
+}
+
+ReadPageGuard::~ReadPageGuard() { release(); }
+
+void ReadPageGuard::release() {
+  if (latch.owns_lock()) {
+    latch.unlock();
+  }
+  unpin(false);
+}
+
+WritePageGuard::WritePageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page, std::shared_mutex &latch)
+    : PageGuard(pool, pid, pos, page), latch(latch) {}
+
+WritePageGuard &WritePageGuard::operator=(WritePageGuard &&other) noexcept {
+  if (this != &other) {
+    release();
+    latch = std::move(other.latch);
+    PageGuard::operator=(std::move(other));
+  }
+  return *this;
+}
+
+WritePageGuard::~WritePageGuard() { release(); }
+
+void WritePageGuard::release() {
+  if (latch.owns_lock()) {
+    latch.unlock();
   }
+  unpin(true);
 }
@@ -0,0 +1,111 @@
+#include <db/Chunk.hpp>
+#include <cstring>
+#include <stdexcept>
+
+using namespace db;
+
+Chunk::Chunk(const TupleDesc &td, size_t capacity) : td(&td), source(&td), max_rows(capacity) {
+  for (size_t i = 0; i < td.size(); ++i) {
+    fields.push_back(i);
+  }
+  allocate();
+}
+
+Chunk::Chunk(const Projection &projection, size_t capacity)
+    : td(&projection.getTupleDesc()), source(&projection.getSource()), fields(projection.getFields()),
+      max_rows(capacity) {
+  allocate();
+}
+
+void Chunk::allocate() {
+  size_t capacity = max_rows;
+  if (capacity == 0) {
+    throw std::logic_error("A chunk must hold at least one row.");
+  }
+  widths.reserve(td->size());
+  columns.reserve(td->size());
+  for (size_t i = 0; i < td->size(); ++i) {
+    widths.push_back(td->field_type(i) == type_t::VARCHAR ? 2 * sizeof(uint32_t) : td->field_size(i));
+    columns.emplace_back(capacity * widths.back());
+  }
+  selected.reserve(capacity);
+}
+
+void Chunk::clear() {
+  rows = 0;
+  chars.clear();
+  selected.clear();
+}
+
+const int *Chunk::ints(size_t i) const {
+  if (td->field_type(i) != type_t::INT) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  return reinterpret_cast<const int *>(columns[i].data());
+}
+
+const double *Chunk::doubles(size_t i) const {
+  if (td->field_type(i) != type_t::DOUBLE) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  return reinterpret_cast<const double *>(columns[i].data());
+}
+
+std::string_view Chunk::get_char(size_t i, size_t row) const {
+  const uint8_t *value = column(i) + row * widths[i];
+  switch (td->field_type(i)) {
+    case type_t::CHAR: {
+      const char *chars = reinterpret_cast<const char *>(value);
+      const void *end = std::memchr(chars, '\0', CHAR_SIZE);
+      return {chars, end == nullptr ? CHAR_SIZE : static_cast<size_t>(static_cast<const char *>(end) - chars)};
+    }
+    case type_t::VARCHAR: {
+      uint32_t location[2];
+      std::memcpy(location, value, sizeof(location));
+      return {chars.data() + location[0], location[1]};
+    }
+    default:
+      throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+}
+
+void Chunk::setVarchar(size_t i, size_t row, std::string_view value) {
+  if (td->field_type(i) != type_t::VARCHAR) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  uint32_t location[2] = {static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(value.size())};
+  std::memcpy(column(i) + row * widths[i], location, sizeof(location));
+  chars.insert(chars.end(), value.begin(), value.end());
+}
+
+void Chunk::append(size_t count) {
+  if (rows + count > max_rows) {
+    throw std::out_of_range("The chunk cannot hold " + std::to_string(count) + " more rows.");
+  }
+  for (size_t row = rows; row < rows + count; ++row) {
+    selected.push_back(static_cast<uint32_t>(row));
+  }
+  rows += count;
+}
+
+Tuple Chunk::materialize(size_t row) const {
+  if (row >= rows) {
+    throw std::out_of_range("Row out of range.");
+  }
+  std::vector<field_t> fields;
+  fields.reserve(td->size());
+  for (size_t i = 0; i < td->size(); ++i) {
+    switch (td->field_type(i)) {
+      case type_t::INT:
+        fields.emplace_back(ints(i)[row]);
+        break;
+      case type_t::DOUBLE:
+        fields.emplace_back(doubles(i)[row]);
+        break;
+      default:
+        fields.emplace_back(std::string(get_char(i, row)));
+        break;
+    }
+  }
+  return Tuple(std::move(fields));
+}
@@ -2,11 +2,34 @@
 
 using namespace db;
 
+namespace {
+// The instance stays reachable while it is being destroyed: the BufferPool flushes its dirty pages through it.
+struct Instance {
+  Database *db = nullptr;
+  ~Instance() { delete db; }
+} instance;
+} // namespace
+
+Database::Database(const DatabaseOptions &options)
+    : ioBackend(makeIoBackend(options.io_backend)), bufferPool(options.buffer_pool) {}
+
 BufferPool &Database::getBufferPool() { return bufferPool; }
 
+IoBackend &Database::getIoBackend() { return *ioBackend; }
+
 Database &db::getDatabase() {
-  static Database instance;
-  return instance;
+  if (instance.db == nullptr) {
+    instance.db = new Database({});
+  }
+  return *instance.db;
+}
+
+Database &db::initDatabase(const DatabaseOptions &options) {
+  if (instance.db != nullptr) {
+    throw std::logic_error("Database already exists");
+  }
+  instance.db = new Database(options);
+  return *instance.db;
 }
 
 void Database::add(std::unique_ptr<DbFile> file) {
@@ -14,16 +37,40 @@ void Database::add(std::unique_ptr<DbFile> file) {
   if (files.contains(name)) {
     throw std::logic_error("File already exists");
   }
+  size_t id = num_ids.load(std::memory_order_relaxed);
+  if (id == ID_CHUNK * ID_CHUNKS) {
+    throw std::length_error("Too many files");
+  }
+  if (id % ID_CHUNK == 0) {
+    ids[id / ID_CHUNK] = std::make_unique<std::atomic<DbFile *>[]>(ID_CHUNK);
+  }
+  file->id = static_cast<file_id_t>(id);
+  ids[id / ID_CHUNK][id % ID_CHUNK].store(file.get(), std::memory_order_relaxed);
+  num_ids.store(id + 1, std::memory_order_release);
   files[name] = std::move(file);
 }
 
 std::unique_ptr<DbFile> Database::remove(const std::string &name) {
-  auto nh = files.extract(name);
-  if (nh.empty()) {
+  auto it = files.find(name);
+  if (it == files.end()) {
     throw std::logic_error("File does not exist");
   }
-  Database::getBufferPool().flushFile(nh.key());
-  return std::move(nh.mapped());
+  // No frame may outlive the file: its pages are written and dropped before it is detached
+  file_id_t id = it->second->getId();
+  if (!bufferPool.flushFile(id)) {
+    throw std::logic_error("Cannot remove a file whose pages are latched for writing");
+  }
+  bufferPool.discardFile(id);
+  ids[id / ID_CHUNK][id % ID_CHUNK].store(nullptr, std::memory_order_relaxed);
+  return std::move(files.extract(it).mapped());
 }
 
 DbFile &Database::get(const std::string &name) const { return *files.at(name); }
+
+DbFile &Database::get(file_id_t id) const {
+  DbFile *file = id < num_ids.load(std::memory_order_acquire) ? ids[id / ID_CHUNK][id % ID_CHUNK].load() : nullptr;
+  if (file == nullptr) {
+    throw std::out_of_range("File id does not exist");
+  }
+  return *file;
+}
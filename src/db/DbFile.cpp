@@ -1,18 +1,48 @@
+#include <db/Database.hpp>
 #include <db/DbFile.hpp>
 #include <stdexcept>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
-#include<cstring>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <optional>
 
 using namespace db;
 
+namespace {
+bool isAligned(const void *p) { return reinterpret_cast<uintptr_t>(p) % DEFAULT_PAGE_SIZE == 0; }
+
+// A page-aligned page for O_DIRECT transfers of pages that are not aligned
+class AlignedPage {
+  Page *page;
+
+public:
+  AlignedPage() : page(static_cast<Page *>(::operator new(sizeof(Page), std::align_val_t{DEFAULT_PAGE_SIZE}))) {}
+  ~AlignedPage() { ::operator delete(page, std::align_val_t{DEFAULT_PAGE_SIZE}); }
+  AlignedPage(const AlignedPage &) = delete;
+  AlignedPage &operator=(const AlignedPage &) = delete;
+  Page &operator*() const { return *page; }
+};
+} // namespace
+
 const TupleDesc &DbFile::getTupleDesc() const { return td; }
 
-DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td) {
+DbFile::DbFile(const std::string &name, const TupleDesc &td, file_mode_t mode, size_t extent)
+    : mode(mode), extent(std::max<size_t>(1, extent)), name(name), td(td) {
   // TODO pa2: open file and initialize numPages
   // Hint: use open, fstat
-  int fileDescriptor = open(name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  int flags = O_RDWR | O_CREAT;
+  fileDescriptor = open(name.c_str(), flags | (mode == file_mode_t::DIRECT ? O_DIRECT : 0), S_IRUSR | S_IWUSR);
+  if (fileDescriptor < 0 && errno == EINVAL && mode == file_mode_t::DIRECT) {
+    // The file system does not support O_DIRECT (e.g. tmpfs)
+    this->mode = file_mode_t::BUFFERED;
+    fileDescriptor = open(name.c_str(), flags, S_IRUSR | S_IWUSR);
+  }
   if (fileDescriptor < 0) {
     throw std::runtime_error("Failed to open file: " + name);
   }
@@ -30,12 +60,24 @@ DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td
   if (numPages == 0) {
     Page emptyPage = {};
     memset(&emptyPage, 0, sizeof(Page));  // Zero out the page data
-    writePage(emptyPage, 0);
     numPages = 1;
+    created = true;
+    writePage(emptyPage, 0);
+  }
+  allocated = numPages;
+
+  if (mode == file_mode_t::MMAP) {
+    remap(write_epoch);
+    if (mapping.load() == nullptr) {
+      this->mode = file_mode_t::BUFFERED;
+    }
   }
 }
 
 DbFile::~DbFile() {
+  for (const auto &m : mappings) {
+    munmap(const_cast<Page *>(m->pages), m->capacity * DEFAULT_PAGE_SIZE);
+  }
   // TODO pa2: close file
   // Hind: use close
   if (fileDescriptor >= 0) {
@@ -43,10 +85,78 @@ DbFile::~DbFile() {
   }
 }
 
+WritePageGuard DbFile::appendPage() {
+  size_t page = numPages.load(std::memory_order_relaxed);
+  if (page == allocated) {
+    // Only a hint: without fallocate support the file system allocates the pages when they are written
+    off_t offset = static_cast<off_t>(allocated * DEFAULT_PAGE_SIZE);
+    fallocate(fileDescriptor, FALLOC_FL_KEEP_SIZE, offset, static_cast<off_t>(extent * DEFAULT_PAGE_SIZE));
+    allocated += extent;
+  }
+  WritePageGuard guard = getDatabase().getBufferPool().newPage({id, page});
+  // Readers that see the page find it in the BufferPool, they never read it from disk before it is written
+  numPages.store(page + 1, std::memory_order_release);
+  return guard;
+}
+
+void DbFile::beginWrite() {
+  write_epoch++;
+  mapped = false;
+}
+
+const Page *DbFile::mappedPage(size_t id) const {
+  if (!mapped) {
+    return nullptr;
+  }
+  const Mapping *m = mapping.load(std::memory_order_acquire);
+  if (id >= numPages || id >= m->capacity) {
+    return nullptr;
+  }
+  return &m->pages[id];
+}
+
+void DbFile::adviseScan() const {
+  const Mapping *m = mapping.load(std::memory_order_acquire);
+  if (mapped && m != nullptr) {
+    void *base = const_cast<Page *>(m->pages);
+    madvise(base, m->capacity * DEFAULT_PAGE_SIZE, MADV_SEQUENTIAL);
+    madvise(base, std::min(numPages.load(), m->capacity) * DEFAULT_PAGE_SIZE, MADV_WILLNEED);
+  }
+}
+
+void DbFile::remap(uint64_t epoch) {
+  if (mode != file_mode_t::MMAP) {
+    return;
+  }
+  std::lock_guard lock(map_mutex);
+  if (write_epoch != epoch) {
+    return;
+  }
+  const Mapping *m = mapping.load();
+  if (m == nullptr || numPages > m->capacity) {
+    // Map twice the file so that it can grow without a remap. Pages past the end of the file are never accessed
+    size_t capacity = std::max<size_t>(2 * numPages, 16);
+    void *pages = mmap(nullptr, capacity * DEFAULT_PAGE_SIZE, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (pages == MAP_FAILED) {
+      return;
+    }
+    mappings.push_back(std::make_unique<Mapping>(Mapping{static_cast<const Page *>(pages), capacity}));
+    mapping.store(mappings.back().get(), std::memory_order_release);
+  }
+  // A write that began in between may have missed the flag: leave it off
+  mapped = true;
+  if (write_epoch != epoch) {
+    mapped = false;
+  }
+}
+
 const std::string &DbFile::getName() const { return name; }
 
 void DbFile::readPage(Page &page, const size_t id) const {
-  reads.push_back(id);
+  {
+    std::lock_guard lock(io_mutex);
+    reads.push_back(id);
+  }
   // TODO pa2: read page
   // Hint: use pread
     // Check if the page ID is within the valid range
@@ -57,15 +167,26 @@ void DbFile::readPage(Page &page, const size_t id) const {
   // Calculate the offset in bytes for the given page ID
   size_t offset = id * DEFAULT_PAGE_SIZE;
 
-  // Read the page using pread
-  ssize_t bytesRead = pread(fileDescriptor, page.data(), DEFAULT_PAGE_SIZE, offset);
+  // Read the page using pread, through an aligned copy if O_DIRECT cannot read it in place
+  std::optional<AlignedPage> aligned;
+  if (mode == file_mode_t::DIRECT && !isAligned(page.data())) {
+    aligned.emplace();
+  }
+  uint8_t *data = aligned ? (**aligned).data() : page.data();
+  ssize_t bytesRead = pread(fileDescriptor, data, DEFAULT_PAGE_SIZE, offset);
   if (bytesRead != DEFAULT_PAGE_SIZE) {
     throw std::runtime_error("Failed to read page " + std::to_string(id) + " from file: " + name);
   }
+  if (aligned) {
+    page = **aligned;
+  }
 }
 
 void DbFile::writePage(const Page &page, const size_t id) const {
-  writes.push_back(id);
+  {
+    std::lock_guard lock(io_mutex);
+    writes.push_back(id);
+  }
   // TODO pa2: write page
   // Hint: use pwrite
     // Check if the page ID is within the valid range
@@ -76,25 +197,92 @@ void DbFile::writePage(const Page &page, const size_t id) const {
   // Calculate the offset in bytes for the given page ID
   size_t offset = id * DEFAULT_PAGE_SIZE;
 
-  // Write the page using pwrite
-  ssize_t bytesWritten = pwrite(fileDescriptor, page.data(), DEFAULT_PAGE_SIZE, offset);
+  // Write the page using pwrite, through an aligned copy if O_DIRECT cannot write it in place
+  std::optional<AlignedPage> aligned;
+  if (mode == file_mode_t::DIRECT && !isAligned(page.data())) {
+    aligned.emplace();
+    **aligned = page;
+  }
+  const uint8_t *data = aligned ? (**aligned).data() : page.data();
+  ssize_t bytesWritten = pwrite(fileDescriptor, data, DEFAULT_PAGE_SIZE, offset);
   if (bytesWritten != DEFAULT_PAGE_SIZE) {
     throw std::runtime_error("Failed to write page " + std::to_string(id) + " to file: " + name);
   }
 }
 
+void DbFile::readPages(size_t first, size_t count, Page *const *frames) const {
+  std::vector<iovec> iov(count);
+  for (size_t i = 0; i < count; i++) {
+    iov[i] = {frames[i]->data(), DEFAULT_PAGE_SIZE};
+  }
+  IoRequest read = request(false, first, iov.data(), count);
+  transfer(read);
+  complete(read);
+}
+
+void DbFile::writePages(size_t first, size_t count, const Page *const *frames) const {
+  std::vector<iovec> iov(count);
+  for (size_t i = 0; i < count; i++) {
+    iov[i] = {const_cast<uint8_t *>(frames[i]->data()), DEFAULT_PAGE_SIZE};
+  }
+  IoRequest write = request(true, first, iov.data(), count);
+  transfer(write);
+  complete(write);
+}
+
+IoRequest DbFile::request(bool write, size_t first, iovec *iov, size_t count) const {
+  {
+    std::lock_guard lock(io_mutex);
+    std::vector<size_t> &accesses = write ? writes : reads;
+    for (size_t i = 0; i < count; i++) {
+      accesses.push_back(first + i);
+    }
+  }
+  if (first + count > numPages) {
+    throw std::out_of_range("Page id " + std::to_string(first + count - 1) + " out of range.");
+  }
+  if (mode == file_mode_t::DIRECT &&
+      std::any_of(iov, iov + count, [](const iovec &buffer) { return !isAligned(buffer.iov_base); })) {
+    throw std::logic_error("O_DIRECT buffers must be aligned to DEFAULT_PAGE_SIZE");
+  }
+  return {fileDescriptor, write, first * DEFAULT_PAGE_SIZE, iov, count};
+}
+
+void DbFile::complete(const IoRequest &request) const {
+  if (request.result < 0 || static_cast<size_t>(request.result) != request.length()) {
+    size_t first = request.offset / DEFAULT_PAGE_SIZE;
+    throw std::runtime_error("Failed to " + std::string(request.write ? "write" : "read") + " pages " +
+                             std::to_string(first) + "-" + std::to_string(first + request.iovcnt - 1) +
+                             (request.write ? " to" : " from") + " file: " + name);
+  }
+}
+
 const std::vector<size_t> &DbFile::getReads() const { return reads; }
 
 const std::vector<size_t> &DbFile::getWrites() const { return writes; }
 
 void DbFile::insertTuple(const Tuple &t) { throw std::runtime_error("Not implemented"); }
 
+void DbFile::insertTuples(std::span<const Tuple> tuples) {
+  for (const Tuple &t : tuples) {
+    insertTuple(t);
+  }
+}
+
+void DbFile::insertRows(std::span<const uint8_t>) { throw std::runtime_error("Not implemented"); }
+
 void DbFile::deleteTuple(const Iterator &it) { throw std::runtime_error("Not implemented"); }
 
 Tuple DbFile::getTuple(const Iterator &it) const { throw std::runtime_error("Not implemented"); }
 
+Tuple DbFile::getTuple(const Iterator &, const Projection &) const { throw std::runtime_error("Not implemented"); }
+
+TupleView DbFile::getTupleView(const Iterator &) const { throw std::runtime_error("Not implemented"); }
+
 void DbFile::next(Iterator &it) const { throw std::runtime_error("Not implemented"); }
 
+size_t DbFile::scan(Iterator &, Chunk &, const Predicate *) const { throw std::runtime_error("Not implemented"); }
+
 Iterator DbFile::begin() const { throw std::runtime_error("Not implemented"); }
 
 Iterator DbFile::end() const { throw std::runtime_error("Not implemented"); }
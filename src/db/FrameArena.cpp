@@ -0,0 +1,44 @@
+#include <db/FrameArena.hpp>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+
+using namespace db;
+
+static_assert(sizeof(Page) == DEFAULT_PAGE_SIZE, "frames must be packed back to back");
+
+FrameArena::FrameArena(size_t capacity, bool huge_pages) : capacity(capacity) {
+  if (!huge_pages) {
+    frames = static_cast<Page *>(::operator new(capacity * sizeof(Page), std::align_val_t{DEFAULT_PAGE_SIZE}));
+    return;
+  }
+  size_t bytes = (capacity * sizeof(Page) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    hugetlb = true;
+  } else {
+    // No huge pages are reserved: map a region aligned to HUGE_PAGE_SIZE and ask for transparent huge pages
+    void *raw = mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > start) {
+      munmap(raw, aligned - start);
+    }
+    munmap(reinterpret_cast<void *>(aligned + bytes), HUGE_PAGE_SIZE - (aligned - start));
+    p = reinterpret_cast<void *>(aligned);
+    madvise(p, bytes, MADV_HUGEPAGE); // only a hint: the frames stay usable without transparent huge pages
+  }
+  frames = static_cast<Page *>(p);
+  mapped = bytes;
+}
+
+FrameArena::~FrameArena() {
+  if (mapped > 0) {
+    munmap(frames, mapped);
+  } else {
+    ::operator delete(frames, std::align_val_t{DEFAULT_PAGE_SIZE});
+  }
+}
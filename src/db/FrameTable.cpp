@@ -0,0 +1,61 @@
+#include <db/FrameTable.hpp>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+using namespace db;
+
+FrameTable::FrameTable(size_t capacity) : slots(std::bit_ceil(std::max<size_t>(2, 2 * capacity))) {
+  shift = 64 - std::countr_zero(slots.size());
+}
+
+size_t FrameTable::home(const PageId &pid) const { return std::hash<PageId>()(pid) >> shift; }
+
+size_t FrameTable::locate(const PageId &pid) const {
+  // The table is never full, so every probe sequence ends at an empty slot
+  size_t mask = slots.size() - 1;
+  for (size_t i = home(pid);; i = (i + 1) & mask) {
+    const PageId &slot = slots[i].pid;
+    if (slot.file == INVALID_FILE_ID) {
+      return npos;
+    }
+    if (slot == pid) {
+      return i;
+    }
+  }
+}
+
+size_t FrameTable::find(const PageId &pid) const {
+  size_t i = locate(pid);
+  return i == npos ? npos : slots[i].pos;
+}
+
+void FrameTable::insert(const PageId &pid, size_t pos) {
+  if (2 * (count + 1) > slots.size()) {
+    throw std::logic_error("FrameTable is full");
+  }
+  size_t mask = slots.size() - 1;
+  size_t i = home(pid);
+  while (slots[i].pid.file != INVALID_FILE_ID) {
+    i = (i + 1) & mask;
+  }
+  slots[i] = {pid, pos};
+  count++;
+}
+
+void FrameTable::erase(const PageId &pid) {
+  size_t hole = locate(pid);
+  if (hole == npos) {
+    return;
+  }
+  // Move back every following entry of the cluster that would not be found past the hole
+  size_t mask = slots.size() - 1;
+  for (size_t i = (hole + 1) & mask; slots[i].pid.file != INVALID_FILE_ID; i = (i + 1) & mask) {
+    if (((i - home(slots[i].pid)) & mask) >= ((i - hole) & mask)) {
+      slots[hole] = slots[i];
+      hole = i;
+    }
+  }
+  slots[hole] = {};
+  count--;
+}
@@ -0,0 +1,105 @@
+#include <db/FreeSpaceMap.hpp>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace db;
+
+namespace {
+constexpr uint64_t FSM_MAGIC = 0x30304d5346626463; // "cdbFSM00"
+
+struct Header {
+  uint64_t magic;
+  uint64_t pages;
+};
+
+bool readAll(int fd, void *data, size_t size, off_t offset) {
+  return pread(fd, data, size, offset) == static_cast<ssize_t>(size);
+}
+} // namespace
+
+FreeSpaceMap::FreeSpaceMap(std::string path) : path(std::move(path)) {}
+
+bool FreeSpaceMap::load(size_t numPages) {
+  bits.clear();
+  candidates.clear();
+  pages = 0;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  Header header{};
+  std::vector<uint8_t> stored((numPages + 7) / 8);
+  struct stat stats {};
+  bool valid = fstat(fd, &stats) == 0 && readAll(fd, &header, sizeof(header), 0) && header.magic == FSM_MAGIC &&
+               header.pages == numPages && static_cast<size_t>(stats.st_size) == sizeof(header) + stored.size() &&
+               readAll(fd, stored.data(), stored.size(), sizeof(header));
+  close(fd);
+  // The map describes the file as it was closed: it is stale as soon as the file changes
+  unlink(path.c_str());
+  if (!valid) {
+    return false;
+  }
+  bits = std::move(stored);
+  pages = numPages;
+  for (size_t page = pages; page-- > 0;) {
+    if (hasRoom(page)) {
+      candidates.push_back(page);
+    }
+  }
+  return true;
+}
+
+void FreeSpaceMap::save() const {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open free space map: " + path);
+  }
+  Header header{FSM_MAGIC, pages};
+  bool written = pwrite(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                 pwrite(fd, bits.data(), bits.size(), sizeof(header)) == static_cast<ssize_t>(bits.size());
+  close(fd);
+  if (!written) {
+    unlink(path.c_str());
+    throw std::runtime_error("Failed to write free space map: " + path);
+  }
+}
+
+bool FreeSpaceMap::hasRoom(size_t page) const {
+  if (page >= pages) {
+    return false;
+  }
+  return bits[page / 8] & (1 << (7 - page % 8));
+}
+
+void FreeSpaceMap::set(size_t page, bool room) {
+  if (page >= pages) {
+    pages = page + 1;
+    bits.resize((pages + 7) / 8);
+  }
+  if (hasRoom(page) == room) {
+    return;
+  }
+  uint8_t mask = 1 << (7 - page % 8);
+  if (room) {
+    bits[page / 8] |= mask;
+    candidates.push_back(page);
+  } else {
+    // The page leaves the stack lazily, in find()
+    bits[page / 8] &= ~mask;
+  }
+}
+
+std::optional<size_t> FreeSpaceMap::find() {
+  // Each page is pushed once per time it is given room, so the pops are paid for by the pushes
+  while (!candidates.empty()) {
+    size_t page = candidates.back();
+    if (hasRoom(page)) {
+      return page;
+    }
+    candidates.pop_back();
+  }
+  return std::nullopt;
+}
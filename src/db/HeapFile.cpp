@@ -1,59 +1,219 @@
 #include <db/Database.hpp>
 #include <db/HeapFile.hpp>
 #include <db/HeapPage.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
 #include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace db;
 
-HeapFile::HeapFile(const std::string &name, const TupleDesc &td) : DbFile(name, td) {}
+namespace {
+constexpr uint64_t LAYOUT_MAGIC = 0x303059414c626463; // "cdbLAY00"
+
+struct LayoutRecord {
+  uint64_t magic;
+  uint64_t layout;
+};
+
+// Records the layout of a new file in its side file, or returns the layout recorded for an existing file
+page_layout_t recordLayout(const std::string &path, bool created, page_layout_t requested) {
+  if (created) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    LayoutRecord record{LAYOUT_MAGIC, static_cast<uint64_t>(requested)};
+    bool written = fd >= 0 && pwrite(fd, &record, sizeof(record), 0) == sizeof(record);
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!written) {
+      throw std::runtime_error("Failed to write page layout: " + path);
+    }
+    return requested;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    // Files created before layouts were recorded are ROW files
+    return page_layout_t::ROW;
+  }
+  LayoutRecord record{};
+  bool valid = pread(fd, &record, sizeof(record), 0) == sizeof(record) && record.magic == LAYOUT_MAGIC &&
+               record.layout <= static_cast<uint64_t>(page_layout_t::PAX);
+  close(fd);
+  if (!valid) {
+    throw std::runtime_error("Invalid page layout: " + path);
+  }
+  return static_cast<page_layout_t>(record.layout);
+}
+
+// Whether tuples of a TupleDesc are laid out like the tuples of another
+bool sameFields(const TupleDesc &a, const TupleDesc &b) {
+  if (&a == &b) {
+    return true;
+  }
+  bool same = a.size() == b.size();
+  for (size_t i = 0; i < a.size() && same; ++i) {
+    same = a.field_type(i) == b.field_type(i);
+  }
+  return same;
+}
+
+// Checks that bytes are whole tuples serialized by td.serialize, so that the pages can copy them as they are
+void checkRows(const TupleDesc &td, std::span<const uint8_t> rows) {
+  if (td.fixed_length()) {
+    if (rows.size() % td.length() != 0) {
+      throw std::logic_error("Rows are not tuples serialized with this TupleDesc.");
+    }
+    return;
+  }
+  for (size_t at = 0; at < rows.size();) {
+    // The characters of the VARCHAR fields follow the fixed part, in the order of the fields
+    size_t end = td.length();
+    bool valid = at + end <= rows.size();
+    for (size_t i = 0; i < td.size() && valid; ++i) {
+      if (td.field_type(i) == type_t::VARCHAR) {
+        uint16_t location[2];
+        std::memcpy(location, rows.data() + at + td.offset_of(i), VARCHAR_SIZE);
+        valid = location[0] == end && location[1] <= td.max_chars(i) && at + end + location[1] <= rows.size();
+        end += location[1];
+      }
+    }
+    if (!valid) {
+      throw std::logic_error("Rows are not tuples serialized with this TupleDesc.");
+    }
+    at += end;
+  }
+}
+} // namespace
+
+HeapFile::HeapFile(const std::string &name, const TupleDesc &td, file_mode_t mode, size_t extent,
+                   page_layout_t pageLayout)
+    : DbFile(name, td, mode, extent), fsm(name + ".fsm"),
+      layout(td, recordLayout(name + ".layout", created, pageLayout)) {
+  if (created) {
+    // Discard the map of a previous file with the same name
+    fsm.load(0);
+    fsm.set(0, true);
+    return;
+  }
+  if (fsm.load(numPages)) {
+    return;
+  }
+  for (size_t page = 0; page < numPages; page++) {
+    Page buffer;
+    readPage(buffer, page);
+    fsm.set(page, !HeapPage(buffer, td, layout).full());
+  }
+}
+
+page_layout_t HeapFile::getPageLayout() const { return layout.pax ? page_layout_t::PAX : page_layout_t::ROW; }
+
+HeapFile::~HeapFile() {
+  try {
+    fsm.save();
+  } catch (const std::runtime_error &) {
+    // The map is rebuilt when the file is opened again
+  }
+}
+
+HeapPage HeapFile::fetchPage(size_t page, access_t access, std::optional<ReadPageGuard> &guard) const {
+  if (const Page *mapped = mappedPage(page)) {
+    return {*mapped, td, layout};
+  }
+  guard.emplace(getDatabase().getBufferPool().fetchRead({id, page}, access));
+  // Readers that find no metadata all store the same value
+  uint64_t meta = guard->getMeta();
+  HeapPage heapPage(**guard, td, layout, meta);
+  if (meta == 0) {
+    guard->setMeta(heapPage.meta());
+  }
+  return heapPage;
+}
 
 void HeapFile::insertTuple(const Tuple &t) {
   // TODO pa2: implement
   // Get the database buffer pool
   BufferPool &bufferPool = getDatabase().getBufferPool();
+  beginWrite();
 
-  // Try to insert into the last page
-  if (numPages > 0) {
-    PageId lastPageId = {name, numPages - 1};
-    Page &lastPage = bufferPool.getPage(lastPageId);
-    HeapPage lastHeapPage(lastPage, td);
+  // Try the pages that have room, most recently freed first
+  while (std::optional<size_t> page = fsm.find()) {
+    WritePageGuard freePage = bufferPool.fetchWrite({id, *page});
+    HeapPage freeHeapPage(*freePage, td, layout, freePage.getMeta());
 
-    if (lastHeapPage.insertTuple(t)) {
-      bufferPool.markDirty(lastPageId);
+    // Releasing the guard marks the page dirty
+    bool inserted = freeHeapPage.insertTuple(t);
+    freePage.setMeta(freeHeapPage.meta());
+    // A slotted page may have room for shorter tuples only: it is tried again once a tuple is deleted from it
+    fsm.set(*page, inserted && !freeHeapPage.full());
+    if (inserted) {
       return;
     }
   }
-  // If last page is full or there are no pages, create a new page
-  Page newPage = {};
-  HeapPage newHeapPage(newPage, td);
+  // If every page is full, create a new page directly in the buffer pool
+  WritePageGuard newPage = appendPage();
+  size_t page = newPage.getPageId().page;
+  HeapPage newHeapPage(*newPage, td, layout);
   if (!newHeapPage.insertTuple(t)) {
     throw std::runtime_error("Failed to insert tuple into new page.");
   }
+  newPage.setMeta(newHeapPage.meta());
+  fsm.set(page, !newHeapPage.full());
+}
 
-  // Write the new page to the file and update the buffer pool
-  writePage(newPage, numPages);
-  numPages++;
+template <class Insert> void HeapFile::fillPages(size_t total, Insert insert) {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  beginWrite();
 
-  // Mark the new page as dirty
-  PageId newPageId = {name, numPages - 1};
-  bufferPool.markDirty(newPageId);
+  for (size_t done = 0; done < total;) {
+    // The pages that have room first, most recently freed first, then new pages built in the buffer pool
+    std::optional<size_t> free = fsm.find();
+    WritePageGuard guard = free ? bufferPool.fetchWrite({id, *free}) : appendPage();
+    size_t page = guard.getPageId().page;
+    HeapPage heapPage(*guard, td, layout, guard.getMeta());
+
+    // Releasing the guard marks the page dirty
+    size_t inserted = insert(heapPage, done);
+    guard.setMeta(heapPage.meta());
+    done += inserted;
+    // A page that stops before the end of the batch has no room for its next tuple, as for insertTuple
+    fsm.set(page, done == total && !heapPage.full());
+    if (!free && inserted == 0) {
+      throw std::runtime_error("Failed to insert tuple into new page.");
+    }
+  }
 }
 
+void HeapFile::insertTuples(std::span<const Tuple> tuples) {
+  for (const Tuple &t : tuples) {
+    if (!td.compatible(t)) {
+      throw std::logic_error("Tuple is not compatible with this TupleDesc.");
+    }
+  }
+  fillPages(tuples.size(), [&](HeapPage &page, size_t done) { return page.insertTuples(tuples.subspan(done)); });
+}
 
+void HeapFile::insertRows(std::span<const uint8_t> rows) {
+  checkRows(td, rows);
+  fillPages(rows.size(), [&](HeapPage &page, size_t done) { return page.insertRows(rows.subspan(done)); });
+}
 
 void HeapFile::deleteTuple(const Iterator &it) {
   // TODO pa2: implement
   // Get the database buffer pool
   BufferPool &bufferPool = getDatabase().getBufferPool();
+  beginWrite();
 
   // Get the page containing the tuple
-  PageId pageId = {name, it.page};
-  Page &page = bufferPool.getPage(pageId);
-  HeapPage heapPage(page, td);
+  WritePageGuard page = bufferPool.fetchWrite({id, it.page});
+  HeapPage heapPage(*page, td, layout, page.getMeta());
 
-  // Delete the tuple at the given slot
+  // Delete the tuple at the given slot, releasing the guard marks the page dirty
   heapPage.deleteTuple(it.slot);
-  bufferPool.markDirty(pageId);
+  page.setMeta(heapPage.meta());
+  fsm.set(it.page, true);
 }
 
 Tuple HeapFile::getTuple(const Iterator &it) const {
@@ -62,37 +222,66 @@ Tuple HeapFile::getTuple(const Iterator &it) const {
   if (it.page >= numPages) {
     throw std::out_of_range("Page id " + std::to_string(it.page) + " out of range.");
   }
-  // Get the database buffer pool
-  BufferPool &bufferPool = getDatabase().getBufferPool();
-
   // Get the page containing the tuple
-  PageId pageId = {name, it.page};
-  Page &page = bufferPool.getPage(pageId);
-  HeapPage heapPage(page, td);
+  std::optional<ReadPageGuard> guard;
+  const HeapPage heapPage = fetchPage(it.page, access_t::NORMAL, guard);
 
   // Return the tuple at the given slot
   return heapPage.getTuple(it.slot);
 }
 
+Tuple HeapFile::getTuple(const Iterator &it, const Projection &projection) const {
+  if (!sameFields(projection.getSource(), td)) {
+    throw std::logic_error("Projection is not compatible with this TupleDesc.");
+  }
+  if (it.page >= numPages) {
+    throw std::out_of_range("Page id " + std::to_string(it.page) + " out of range.");
+  }
+  std::optional<ReadPageGuard> guard;
+  const HeapPage heapPage = fetchPage(it.page, access_t::NORMAL, guard);
+  return heapPage.getTuple(it.slot, projection);
+}
+
+TupleView HeapFile::getTupleView(const Iterator &it) const {
+  if (it.page >= numPages) {
+    throw std::out_of_range("Page id " + std::to_string(it.page) + " out of range.");
+  }
+  const Page *page = mappedPage(it.page);
+  if (page == nullptr) {
+    PageId pid{id, it.page};
+    if (!it.pinned || it.pinned.getPageId() != pid) {
+      it.pinned = getDatabase().getBufferPool().fetchPinned(pid);
+    }
+    page = &*it.pinned;
+  }
+  return layout.view(*page, td, it.slot);
+}
+
 void HeapFile::next(Iterator &it) const {
   // TODO pa2: implement
-  // Get the database buffer pool
-  BufferPool &bufferPool = getDatabase().getBufferPool();
-
-  while (it.page < numPages) {
-    PageId pageId = {name, it.page};
-    Page &page = bufferPool.getPage(pageId);
-    HeapPage heapPage(page, td);
+  // Advance within the current page
+  if (it.page < numPages) {
+    std::optional<ReadPageGuard> guard;
+    const HeapPage heapPage = fetchPage(it.page, access_t::SEQUENTIAL, guard);
 
     heapPage.next(it.slot);
 
     if (it.slot < heapPage.end()) {
       return;  // Found the next tuple
     }
-
-    // Move to the next page
     it.page++;
+  }
+
+  // Move to the first occupied slot of the subsequent pages
+  while (it.page < numPages) {
+    std::optional<ReadPageGuard> guard;
+    const HeapPage heapPage = fetchPage(it.page, access_t::SEQUENTIAL, guard);
+
     it.slot = heapPage.begin();
+    if (it.slot != heapPage.end()) {
+      return;
+    }
+    it.page++;
   }
 
   // If no more tuples, set iterator to end position
@@ -100,18 +289,40 @@ void HeapFile::next(Iterator &it) const {
   it.slot = 0;
 }
 
+size_t HeapFile::scan(Iterator &it, Chunk &chunk, const Predicate *predicate) const {
+  if (!sameFields(chunk.getSource(), td)) {
+    throw std::logic_error("Chunk is not compatible with this TupleDesc.");
+  }
+  if (predicate != nullptr) {
+    predicate->check(td);
+  }
+  chunk.clear();
+  while (it.page < numPages && !chunk.full()) {
+    std::optional<ReadPageGuard> guard;
+    const HeapPage heapPage = fetchPage(it.page, access_t::SEQUENTIAL, guard);
+    it.slot = heapPage.scan(it.slot, chunk, predicate);
+    if (it.slot != heapPage.end()) {
+      return chunk.size();  // The rest of the page goes to the next chunk
+    }
+    it.page++;
+    it.slot = 0;
+  }
+  if (it.page >= numPages) {
+    it.page = numPages;
+    it.slot = 0;
+  }
+  return chunk.size();
+}
+
 Iterator HeapFile::begin() const {
   // TODO pa2: implement
   size_t pageId = 0;
-
-  // Get the database buffer pool
-  BufferPool &bufferPool = getDatabase().getBufferPool();
+  adviseScan();
 
   // Iterate over pages to find the first non-empty page
   while (pageId < numPages) {
-    PageId pid = {name, pageId};
-    Page &page = bufferPool.getPage(pid);
-    HeapPage heapPage(page, td);
+    std::optional<ReadPageGuard> guard;
+    const HeapPage heapPage = fetchPage(pageId, access_t::SEQUENTIAL, guard);
 
     size_t firstSlot = heapPage.begin();
     if (firstSlot != heapPage.end()) {
@@ -1,35 +1,230 @@
 #include <db/Database.hpp>
 #include <db/HeapPage.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <stdexcept>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace db;
 
-HeapPage::HeapPage(Page &page, const TupleDesc &td) : td(td) {
+namespace {
+constexpr size_t WORD_BITS = 64;
+
+// The header of a slotted page: the number of slots and the offset of the first tuple byte (0 for an empty page)
+constexpr size_t SLOTTED_HEADER_SIZE = 2 * sizeof(uint16_t);
+constexpr size_t SLOT_SIZE = 2 * sizeof(uint16_t);
+
+size_t load16(const uint8_t *p) {
+  uint16_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+void store16(uint8_t *p, size_t value) {
+  auto v = static_cast<uint16_t>(value);
+  std::memcpy(p, &v, sizeof(v));
+}
+
+size_t heapStart(const uint8_t *page) {
+  size_t heap = load16(page + sizeof(uint16_t));
+  return heap == 0 ? DEFAULT_PAGE_SIZE : heap;
+}
+
+// The bits of word w that hold slots below the capacity
+uint64_t validBits(size_t w, size_t capacity) {
+  size_t end = (w + 1) * WORD_BITS;
+  return end > capacity ? ~uint64_t{0} << (end - capacity) : ~uint64_t{0};
+}
+
+// Copies the values of Size bytes at base + starts[k] to an array
+template <size_t Size> void gather(uint8_t *dst, const uint8_t *base, const uint32_t *starts, size_t n) {
+  for (size_t k = 0; k < n; ++k) {
+    std::memcpy(dst + k * Size, base + starts[k], Size);
+  }
+}
+
+// The tuples of a batch insert, checked by the caller
+struct TupleSource {
+  const TupleDesc &td;
+  std::span<const Tuple> tuples;
+  size_t next = 0;
+
+  bool done() const { return next == tuples.size(); }
+
+  size_t length() const { return td.length(tuples[next]); }
+
+  void write(uint8_t *dest, size_t) { td.serialize_unchecked(dest, tuples[next++]); }
+};
+
+// Serialized tuples, one after the other
+struct RowSource {
+  const TupleDesc &td;
+  std::span<const uint8_t> rows;
+  size_t next = 0; // the offset of the next tuple
+
+  bool done() const { return next == rows.size(); }
+
+  size_t length() const { return td.fixed_length() ? td.length() : TupleView(td, rows.data() + next).length(); }
+
+  void write(uint8_t *dest, size_t size) {
+    std::memcpy(dest, rows.data() + next, size);
+    next += size;
+  }
+};
+
+#ifdef __AVX2__
+// Whether the 256 slots of the header at p are all free (when looking for a used slot) or all used
+bool uniform(const uint8_t *p, bool used) {
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  return used ? _mm256_testz_si256(v, v) : _mm256_testc_si256(v, _mm256_set1_epi8(-1));
+}
+#endif
+} // namespace
+
+HeapPageLayout::HeapPageLayout(const TupleDesc &td, page_layout_t kind)
+    : length(td.length()), slotted(!td.fixed_length()), pax(kind == page_layout_t::PAX) {
+  if (slotted && pax) {
+    throw std::logic_error("PAX pages require tuples of a fixed length.");
+  }
+  capacity = (DEFAULT_PAGE_SIZE * 8) / (length * 8 + 1);  // Calculate number of slots
+  data = DEFAULT_PAGE_SIZE - length * capacity;  // Data is stored at the end of the page, after the padding
+  if (slotted) {
+    // The longest tuple must fit in an empty page
+    size_t longest = length;
+    for (size_t i = 0; i < td.size(); ++i) {
+      longest += td.field_type(i) == type_t::VARCHAR ? td.max_chars(i) : 0;
+    }
+    if (SLOTTED_HEADER_SIZE + SLOT_SIZE + longest > DEFAULT_PAGE_SIZE) {
+      throw std::logic_error("A tuple may not fit in a page.");
+    }
+  }
+}
+
+TupleView HeapPageLayout::view(const Page &page, const TupleDesc &td, size_t slot) const {
+  if (slotted) {
+    if (slot >= load16(page.data())) {
+      throw std::runtime_error("Slot out of range.");
+    }
+    const uint8_t *entry = page.data() + SLOTTED_HEADER_SIZE + slot * SLOT_SIZE;
+    if (load16(entry + sizeof(uint16_t)) == 0) {
+      throw std::logic_error("Slot is empty.");
+    }
+    return {td, page.data() + load16(entry)};
+  }
+  if (slot >= capacity) {
+    throw std::runtime_error("Slot out of range.");
+  }
+  if ((page[slot / 8] & (1 << (7 - slot % 8))) == 0) {
+    throw std::logic_error("Slot is empty.");
+  }
+  if (pax) {
+    return {td, page.data() + data, capacity, slot};
+  }
+  return {td, page.data() + data + slot * length};
+}
+
+const uint8_t *HeapPageLayout::column(const Page &page, const TupleDesc &td, size_t i) const {
+  if (!pax) {
+    throw std::logic_error("The fields are only stored in arrays in PAX pages.");
+  }
+  return page.data() + data + capacity * td.offset_of(i);
+}
+
+HeapPage::HeapPage(Page &page, const TupleDesc &td) : HeapPage(page, td, HeapPageLayout(td)) {}
+
+HeapPage::HeapPage(Page &page, const TupleDesc &td, const HeapPageLayout &layout, uint64_t meta)
+    : td(td), capacity(layout.capacity), length(layout.length), slotted(layout.slotted), pax(layout.pax) {
   // TODO pa2: initialize private members
   // NOTE: header and data should point to locations inside the page buffer. Do not allocate extra memory.
   // Initialize header and data pointers
-  capacity = (DEFAULT_PAGE_SIZE * 8) / (td.length() * 8 + 1);  // Calculate number of slots
   header = page.data();  // Header is at the beginning of the page
-  data = page.data() + (capacity + 7) / 8;  // Header is stored in bits, so divide by 8 to get bytes
+  data = page.data() + layout.data;
+  if (slotted) {
+    capacity = load16(header);
+  }
 
-  // Zero out the header initially
+  if (meta != 0) {
+    count = meta & UINT32_MAX;
+    hint = (meta >> 32) & INT32_MAX;
+    return;
+  }
   count = 0;
-  for(size_t i = 0; i < capacity; ++i){
-    if(!empty(i)){
-      count++;
+  hint = 0;
+  if (slotted) {
+    for (size_t slot = 0; slot < capacity; ++slot) {
+      count += entry(slot).second != 0;
     }
+    return;
+  }
+  // Count the occupied slots a word at a time
+  for (size_t w = 0; w * WORD_BITS < capacity; ++w) {
+    count += std::popcount(word(w));
   }
-  //count++;
 }
 
-size_t HeapPage::begin() const {
-  // TODO pa2: implement
-  for (size_t i = 0; i < capacity; ++i) {
-    if (!empty(i)) {
-      return i;
+std::pair<size_t, size_t> HeapPage::entry(size_t slot) const {
+  const uint8_t *p = header + SLOTTED_HEADER_SIZE + slot * SLOT_SIZE;
+  return {load16(p), load16(p + sizeof(uint16_t))};
+}
+
+void HeapPage::setEntry(size_t slot, size_t offset, size_t size) {
+  uint8_t *p = header + SLOTTED_HEADER_SIZE + slot * SLOT_SIZE;
+  store16(p, offset);
+  store16(p + sizeof(uint16_t), size);
+}
+
+size_t HeapPage::freeSpace() const { return heapStart(header) - SLOTTED_HEADER_SIZE - capacity * SLOT_SIZE; }
+
+uint64_t HeapPage::meta() const { return uint64_t{1} << 63 | static_cast<uint64_t>(hint) << 32 | count; }
+
+uint64_t HeapPage::word(size_t w) const {
+  // The last word may extend past the header: only its header bytes are read
+  size_t offset = w * sizeof(uint64_t);
+  uint64_t bits = 0;
+  std::memcpy(&bits, header + offset, std::min(sizeof(uint64_t), (capacity + 7) / 8 - offset));
+  if constexpr (std::endian::native == std::endian::little) {
+    bits = __builtin_bswap64(bits);
+  }
+  return bits & validBits(w, capacity);
+}
+
+size_t HeapPage::find(size_t from, bool used) const {
+  if (from >= capacity) {
+    return capacity;
+  }
+  if (slotted) {
+    while (from < capacity && (entry(from).second != 0) != used) {
+      from++;
     }
+    return from;
   }
-  return capacity;
+  auto slots = [&](size_t w) { return used ? word(w) : ~word(w) & validBits(w, capacity); };
+  size_t w = from / WORD_BITS;
+  uint64_t bits = slots(w) & (~uint64_t{0} >> (from % WORD_BITS));
+  while (bits == 0) {
+    if (++w * WORD_BITS >= capacity) {
+      return capacity;
+    }
+#ifdef __AVX2__
+    // Skip 4 words at a time while the header has no slot of the kind
+    while ((w + 4) * WORD_BITS <= capacity && uniform(header + w * sizeof(uint64_t), used)) {
+      w += 4;
+    }
+    if (w * WORD_BITS >= capacity) {
+      return capacity;
+    }
+#endif
+    bits = slots(w);
+  }
+  return w * WORD_BITS + std::countl_zero(bits);
+}
+
+size_t HeapPage::begin() const {
+  // TODO pa2: implement
+  return find(0, true);
 }
 
 size_t HeapPage::end() const {
@@ -37,20 +232,111 @@ size_t HeapPage::end() const {
   return capacity;
 }
 
+bool HeapPage::full() const {
+  if (slotted) {
+    // Room for the shortest tuple, and for its slot unless one is empty
+    return freeSpace() < length + (count < capacity ? 0 : SLOT_SIZE);
+  }
+  return count == capacity;
+}
+
 bool HeapPage::insertTuple(const Tuple &t) {
   // TODO pa2: implement
-  for (size_t i = 0; i < capacity; ++i) {
-    if (empty(i)) {
-      // Mark slot as used in the header
-      int bitIndex = 7 - i % 8;
-      header[i / 8] |= (1 << bitIndex);
-      count++;
-      // Serialize the tuple into the data section
-      td.serialize(data + i * td.length(), t);
-      return true;
+  if (slotted) {
+    if (!td.compatible(t)) {
+      throw std::logic_error("Tuple is not compatible with this TupleDesc.");
+    }
+    size_t size = td.length(t);
+    size_t slot = find(hint, false);
+    if (freeSpace() < size + (slot == capacity ? SLOT_SIZE : 0)) {
+      return false;
+    }
+    size_t offset = heapStart(header) - size;
+    td.serialize(header + offset, t);
+    store16(header + sizeof(uint16_t), offset);
+    if (slot == capacity) {
+      store16(header, ++capacity);
+    }
+    setEntry(slot, offset, size);
+    count++;
+    hint = slot + 1;
+    return true;
+  }
+  if (count == capacity) {
+    return false;  // No empty slots available
+  }
+  size_t i = find(hint, false);
+  // Serialize the tuple into the data section first: the slot stays free if the tuple does not match td
+  if (pax) {
+    // Scatter the fields of the serialized tuple to the arrays
+    uint8_t row[DEFAULT_PAGE_SIZE];
+    td.serialize(row, t);
+    for (size_t field = 0; field < td.size(); ++field) {
+      size_t offset = td.offset_of(field);
+      size_t size = td.field_size(field);
+      std::memcpy(data + offset * capacity + size * i, row + offset, size);
+    }
+  } else {
+    td.serialize(data + i * length, t);
+  }
+  // Mark slot as used in the header
+  int bitIndex = 7 - i % 8;
+  header[i / 8] |= (1 << bitIndex);
+  count++;
+  hint = i + 1;
+  return true;
+}
+
+template <class Source> size_t HeapPage::fill(Source &source) {
+  size_t inserted = 0;
+  size_t slot = find(hint, false);
+  if (slotted) {
+    while (!source.done()) {
+      size_t size = source.length();
+      if (freeSpace() < size + (slot == capacity ? SLOT_SIZE : 0)) {
+        break;
+      }
+      size_t offset = heapStart(header) - size;
+      source.write(header + offset, size);
+      store16(header + sizeof(uint16_t), offset);
+      if (slot == capacity) {
+        store16(header, ++capacity);
+      }
+      setEntry(slot, offset, size);
+      inserted++;
+      slot = find(slot + 1, false);
+    }
+  } else {
+    uint8_t row[DEFAULT_PAGE_SIZE];
+    for (; slot < capacity && !source.done(); slot = find(slot + 1, false)) {
+      if (pax) {
+        source.write(row, length);
+        for (size_t field = 0; field < td.size(); ++field) {
+          size_t offset = td.offset_of(field);
+          size_t size = td.field_size(field);
+          std::memcpy(data + offset * capacity + size * slot, row + offset, size);
+        }
+      } else {
+        source.write(data + slot * length, length);
+      }
+      header[slot / 8] |= 1 << (7 - slot % 8);
+      inserted++;
     }
   }
-  return false;  // No empty slots available
+  count += inserted;
+  hint = slot;
+  return inserted;
+}
+
+size_t HeapPage::insertTuples(std::span<const Tuple> tuples) {
+  TupleSource source{td, tuples};
+  return fill(source);
+}
+
+size_t HeapPage::insertRows(std::span<const uint8_t> rows) {
+  RowSource source{td, rows};
+  fill(source);
+  return source.next;
 }
 
 void HeapPage::deleteTuple(size_t slot) {
@@ -62,10 +348,32 @@ void HeapPage::deleteTuple(size_t slot) {
     throw std::logic_error("Slot is already empty.");
   }
 
+  count--;
+  hint = std::min(hint, slot);
+  if (slotted) {
+    // Move the tuples stored before this one over it, so that the free space stays contiguous
+    auto [offset, size] = entry(slot);
+    size_t heap = heapStart(header);
+    std::memmove(header + heap + size, header + heap, offset - heap);
+    store16(header + sizeof(uint16_t), heap + size == DEFAULT_PAGE_SIZE ? 0 : heap + size);
+    setEntry(slot, 0, 0);
+    for (size_t i = 0; i < capacity; ++i) {
+      auto [other, otherSize] = entry(i);
+      if (otherSize != 0 && other < offset) {
+        setEntry(i, other + size, otherSize);
+      }
+    }
+    // Drop the empty slots at the end of the directory
+    while (capacity > 0 && entry(capacity - 1).second == 0) {
+      capacity--;
+    }
+    store16(header, capacity);
+    return;
+  }
+
   // Mark the slot as empty in the header
   int bitIndex = 7 - slot % 8;
   header[slot / 8] &= ~(1 << bitIndex);
-  count--;
 }
 
 Tuple HeapPage::getTuple(size_t slot) const {
@@ -83,17 +391,119 @@ Tuple HeapPage::getTuple(size_t slot) const {
   }
 
   // Deserialize and return the tuple from the data section
-  return td.deserialize(data + slot * td.length());
+  if (slotted) {
+    return td.deserialize(header + entry(slot).first);
+  }
+  if (pax) {
+    return TupleView(td, data, capacity, slot).materialize();
+  }
+  return td.deserialize(data + slot * length);
+}
+
+Tuple HeapPage::getTuple(size_t slot, const Projection &projection) const {
+  if (slot >= capacity) {
+    throw std::runtime_error("Slot out of range.");
+  }
+  if (empty(slot)) {
+    throw std::logic_error("Slot is empty.");
+  }
+  if (slotted) {
+    return projection.deserialize(header + entry(slot).first);
+  }
+  if (pax) {
+    return projection.materialize(TupleView(td, data, capacity, slot));
+  }
+  return projection.deserialize(data + slot * length);
 }
 
 void HeapPage::next(size_t &slot) const {
   // TODO pa2: implement
-  for (++slot; slot < capacity; ++slot) {
-    if (!empty(slot)) {
-      return;
+  slot = find(slot + 1, true);  // capacity if no more populated slots are found
+}
+
+size_t HeapPage::scan(size_t slot, Chunk &chunk, const Predicate *predicate) const {
+  uint32_t slots[MAX_PAGE_SLOTS];
+  uint32_t starts[MAX_PAGE_SLOTS];
+  size_t first = chunk.size();
+  size_t room = chunk.capacity() - first;
+  size_t from = slot / WORD_BITS;
+  size_t end = (capacity + WORD_BITS - 1) / WORD_BITS;
+
+  // The occupied slots from the first one, in the order of the header
+  uint64_t words[MAX_PAGE_SLOTS / WORD_BITS];
+  for (size_t w = from; w < end; ++w) {
+    if (slotted) {
+      words[w] = 0;
+      for (size_t s = w * WORD_BITS; s < std::min((w + 1) * WORD_BITS, capacity); ++s) {
+        words[w] |= static_cast<uint64_t>(entry(s).second != 0) << (WORD_BITS - 1 - s % WORD_BITS);
+      }
+    } else {
+      words[w] = word(w);
+    }
+  }
+  if (from < end) {
+    words[from] &= ~uint64_t{0} >> (slot % WORD_BITS);
+  }
+  if (predicate != nullptr) {
+    // Evaluate the predicate on the bytes of the page: only the slots that satisfy it are copied
+    for (size_t s = 0; s < capacity && !pax; ++s) {
+      starts[s] = static_cast<uint32_t>(slotted ? entry(s).first : data - header + s * length);
+    }
+    PageFields fields{pax ? data : header, pax ? capacity : 1, pax ? nullptr : starts, capacity};
+    predicate->evaluate(td, fields, from, words);
+  }
+
+  // The slots that fit in the chunk
+  size_t n = 0;
+  slot = capacity;
+  for (size_t w = from; w < end && slot == capacity; ++w) {
+    uint64_t bits = words[w];
+    while (bits != 0) {
+      size_t s = w * WORD_BITS + std::countl_zero(bits);
+      if (n == room) {
+        slot = s;
+        break;
+      }
+      slots[n++] = static_cast<uint32_t>(s);
+      bits &= ~(uint64_t{1} << (WORD_BITS - 1 - s % WORD_BITS));
     }
   }
-  slot = capacity;  // Set to end if no more populated slots are found
+
+  // The offset of each tuple in the page, unless its fields are in arrays
+  for (size_t k = 0; k < n && !pax; ++k) {
+    starts[k] = static_cast<uint32_t>(slotted ? entry(slots[k]).first : data - header + slots[k] * length);
+  }
+  for (size_t i = 0; i < chunk.getTupleDesc().size(); ++i) {
+    size_t field = chunk.field(i);
+    size_t offset = td.offset_of(field);
+    size_t size = td.field_size(field);
+    const uint8_t *base = pax ? data + offset * capacity : header + offset;
+    for (size_t k = 0; k < n && pax; ++k) {
+      starts[k] = static_cast<uint32_t>(slots[k] * size);
+    }
+    uint8_t *dst = chunk.column(i) + first * chunk.width(i);
+    switch (td.field_type(field)) {
+      case type_t::INT:
+        gather<INT_SIZE>(dst, base, starts, n);
+        break;
+      case type_t::DOUBLE:
+        gather<DOUBLE_SIZE>(dst, base, starts, n);
+        break;
+      case type_t::CHAR:
+        gather<CHAR_SIZE>(dst, base, starts, n);
+        break;
+      case type_t::VARCHAR:
+        // The characters are located relative to the start of the tuple
+        for (size_t k = 0; k < n; ++k) {
+          const uint8_t *tuple = header + starts[k];
+          const char *chars = reinterpret_cast<const char *>(tuple + load16(base + starts[k]));
+          chunk.setVarchar(i, first + k, {chars, load16(base + starts[k] + sizeof(uint16_t))});
+        }
+        break;
+    }
+  }
+  chunk.append(n);
+  return slot;
 }
 
 bool HeapPage::empty(size_t slot) const {
@@ -102,6 +512,9 @@ bool HeapPage::empty(size_t slot) const {
     return true;
   }
 
+  if (slotted) {
+    return entry(slot).second == 0;
+  }
   // Check the corresponding bit in the header
   int bitIndex = 7 - slot % 8;
   return (header[slot / 8] & (1 << bitIndex)) == 0;
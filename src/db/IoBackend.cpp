@@ -0,0 +1,226 @@
+#include <db/IoBackend.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace db;
+
+size_t IoRequest::length() const {
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++) {
+    total += iov[i].iov_len;
+  }
+  return total;
+}
+
+void db::transfer(IoRequest &request) {
+  size_t total = request.length();
+  size_t index = 0; // first buffer that is not done
+  size_t skip = static_cast<size_t>(request.result);
+  while (index < request.iovcnt && skip >= request.iov[index].iov_len) {
+    skip -= request.iov[index++].iov_len;
+  }
+  while (static_cast<size_t>(request.result) < total) {
+    // Skip the part of the first buffer that is done, at most IOV_MAX buffers per call
+    iovec head = request.iov[index];
+    request.iov[index].iov_base = static_cast<uint8_t *>(head.iov_base) + skip;
+    request.iov[index].iov_len -= skip;
+    int n = static_cast<int>(std::min<size_t>(request.iovcnt - index, IOV_MAX));
+    off_t offset = static_cast<off_t>(request.offset + request.result);
+    ssize_t done = request.write ? pwritev(request.fd, &request.iov[index], n, offset)
+                                 : preadv(request.fd, &request.iov[index], n, offset);
+    request.iov[index] = head;
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      // A read past the end of the file transfers nothing
+      request.result = done < 0 ? -errno : -EIO;
+      return;
+    }
+    request.result += done;
+    skip += done;
+    while (index < request.iovcnt && skip >= request.iov[index].iov_len) {
+      skip -= request.iov[index++].iov_len;
+    }
+  }
+}
+
+void SyncIoBackend::submit(std::span<IoRequest> requests) {
+  for (IoRequest &request : requests) {
+    request.result = 0;
+    transfer(request);
+  }
+}
+
+namespace {
+int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+// The ring indices are shared with the kernel
+unsigned loadAcquire(unsigned *p) { return std::atomic_ref(*p).load(std::memory_order_acquire); }
+
+void storeRelease(unsigned *p, unsigned v) { std::atomic_ref(*p).store(v, std::memory_order_release); }
+} // namespace
+
+IoUringBackend::IoUringBackend(unsigned entries) {
+  io_uring_params params{};
+  ring_fd = io_uring_setup(entries, &params);
+  if (ring_fd < 0) {
+    throw std::runtime_error(std::string("io_uring is not available: ") + strerror(errno));
+  }
+  this->entries = params.sq_entries;
+
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) {
+    sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+  }
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_SHARED | MAP_POPULATE;
+  sq_ring = mmap(nullptr, sq_ring_size, prot, flags, ring_fd, IORING_OFF_SQ_RING);
+  cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, prot, flags, ring_fd, IORING_OFF_CQ_RING);
+  void *sqes_map = mmap(nullptr, sqes_size, prot, flags, ring_fd, IORING_OFF_SQES);
+  if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes_map == MAP_FAILED) {
+    int error = errno;
+    if (sq_ring != MAP_FAILED) {
+      munmap(sq_ring, sq_ring_size);
+    }
+    if (!single && cq_ring != MAP_FAILED) {
+      munmap(cq_ring, cq_ring_size);
+    }
+    if (sqes_map != MAP_FAILED) {
+      munmap(sqes_map, sqes_size);
+    }
+    close(ring_fd);
+    throw std::runtime_error(std::string("Failed to map the io_uring: ") + strerror(error));
+  }
+  sqes = static_cast<io_uring_sqe *>(sqes_map);
+
+  auto *sq = static_cast<uint8_t *>(sq_ring);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto *cq = static_cast<uint8_t *>(cq_ring);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoUringBackend::~IoUringBackend() {
+  munmap(sqes, sqes_size);
+  if (cq_ring != sq_ring) {
+    munmap(cq_ring, cq_ring_size);
+  }
+  munmap(sq_ring, sq_ring_size);
+  close(ring_fd);
+}
+
+int IoUringBackend::enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return io_uring_enter(ring_fd, to_submit, min_complete, flags);
+}
+
+void IoUringBackend::submit(std::span<IoRequest> requests) {
+  std::lock_guard lock(mutex);
+  for (size_t i = 0; i < requests.size(); i += entries) {
+    submitChunk(requests.subspan(i, std::min<size_t>(entries, requests.size() - i)));
+  }
+  // The kernel may transfer less than asked, e.g. when a read reaches the end of the file
+  for (IoRequest &request : requests) {
+    if (request.result >= 0 && static_cast<size_t>(request.result) < request.length()) {
+      transfer(request);
+    }
+  }
+}
+
+void IoUringBackend::submitChunk(std::span<IoRequest> requests) {
+  // Queue every request, then publish them to the kernel at once
+  batch++;
+  unsigned tail = *sq_tail;
+  for (size_t i = 0; i < requests.size(); i++) {
+    IoRequest &request = requests[i];
+    request.result = 0;
+    if (request.iovcnt > IOV_MAX) {
+      // Too many buffers for a single operation: submit() completes it synchronously
+      continue;
+    }
+    unsigned index = tail & sq_mask;
+    io_uring_sqe &sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = request.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(request.iov);
+    sqe.len = static_cast<uint32_t>(request.iovcnt);
+    sqe.off = request.offset;
+    sqe.user_data = static_cast<uint64_t>(batch) << 32 | i;
+    sq_array[index] = index;
+    tail++;
+  }
+  unsigned queued = tail - *sq_tail;
+  storeRelease(sq_tail, tail);
+
+  // Submit and wait for all the completions, reaping them as they arrive
+  unsigned unsubmitted = queued;
+  unsigned completed = 0;
+  while (completed < queued) {
+    unsigned head = *cq_head;
+    unsigned ready = loadAcquire(cq_tail);
+    for (; head != ready; head++) {
+      const io_uring_cqe &cqe = cqes[head & cq_mask];
+      if (cqe.user_data >> 32 == batch) {
+        requests[cqe.user_data & UINT32_MAX].result = cqe.res;
+        completed++;
+      }
+    }
+    storeRelease(cq_head, head);
+    if (completed == queued) {
+      break;
+    }
+    int submitted = enter(unsubmitted, 1, IORING_ENTER_GETEVENTS);
+    if (submitted >= 0) {
+      unsubmitted -= static_cast<unsigned>(submitted);
+      continue;
+    }
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY || unsubmitted == 0) {
+      // The requests in flight own their buffers until they complete: keep waiting for them
+      continue;
+    }
+    // The kernel takes the requests in order: withdraw the ones it has not taken, which fail, and wait for the others
+    int error = errno;
+    tail = *sq_tail - unsubmitted;
+    storeRelease(sq_tail, tail);
+    for (unsigned index = tail; index != tail + unsubmitted; index++) {
+      requests[sqes[sq_array[index & sq_mask]].user_data & UINT32_MAX].result = -error;
+    }
+    queued -= unsubmitted;
+    unsubmitted = 0;
+  }
+}
+
+std::unique_ptr<IoBackend> db::makeIoBackend(io_backend_t kind) {
+  if (kind == io_backend_t::IO_URING) {
+    try {
+      return std::make_unique<IoUringBackend>();
+    } catch (const std::runtime_error &) {
+      // Kernels without io_uring, or with io_uring disabled, use blocking I/O
+    }
+  }
+  return std::make_unique<SyncIoBackend>();
+}
@@ -7,6 +7,10 @@ Iterator::Iterator(const DbFile &file, const size_t &page, size_t slot) : file(f
 
 Tuple Iterator::operator*() const { return file.getTuple(*this); }
 
+Tuple Iterator::project(const Projection &projection) const { return file.getTuple(*this, projection); }
+
+TupleView Iterator::view() const { return file.getTupleView(*this); }
+
 Iterator &Iterator::operator++() {
   file.next(*this);
   return *this;
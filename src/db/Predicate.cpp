@@ -0,0 +1,342 @@
+#include <db/Predicate.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace db;
+
+namespace {
+constexpr size_t WORD_BITS = 64;
+constexpr uint64_t FIRST_BIT = uint64_t{1} << (WORD_BITS - 1);
+
+// The kernels set the bit of slot 64 * w + k in bit k of word w; the header has it in bit 63 - k
+uint64_t reverse(uint64_t x) {
+  x = (x >> 1 & 0x5555555555555555) | (x & 0x5555555555555555) << 1;
+  x = (x >> 2 & 0x3333333333333333) | (x & 0x3333333333333333) << 2;
+  x = (x >> 4 & 0x0f0f0f0f0f0f0f0f) | (x & 0x0f0f0f0f0f0f0f0f) << 4;
+  return __builtin_bswap64(x);
+}
+
+template <class T> T load(const uint8_t *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <op_t Op, class T> bool holds(T a, T b) {
+  if constexpr (Op == op_t::EQ) {
+    return a == b;
+  } else if constexpr (Op == op_t::NE) {
+    return a != b;
+  } else if constexpr (Op == op_t::LT) {
+    return a < b;
+  } else if constexpr (Op == op_t::LE) {
+    return a <= b;
+  } else if constexpr (Op == op_t::GT) {
+    return a > b;
+  } else {
+    return a >= b;
+  }
+}
+
+template <class T> bool holds(op_t op, T a, T b) {
+  switch (op) {
+    case op_t::EQ:
+      return holds<op_t::EQ>(a, b);
+    case op_t::NE:
+      return holds<op_t::NE>(a, b);
+    case op_t::LT:
+      return holds<op_t::LT>(a, b);
+    case op_t::LE:
+      return holds<op_t::LE>(a, b);
+    case op_t::GT:
+      return holds<op_t::GT>(a, b);
+    default:
+      return holds<op_t::GE>(a, b);
+  }
+}
+
+bool holds(op_t op, std::string_view a, const std::string &b) {
+  switch (op) {
+    case op_t::EQ:
+      return a == b;
+    case op_t::NE:
+      return a != b;
+    default:
+      return a.starts_with(b);
+  }
+}
+
+// Compares `lanes` values from slot s at once; bit j of the mask is slot s + j. The values are loaded from an array if
+// starts is null, gathered from the tuples otherwise
+template <class T> struct Kernel {
+  static constexpr size_t lanes = 0;
+};
+
+#ifdef __AVX2__
+template <> struct Kernel<int> {
+  static constexpr size_t lanes = 8;
+
+  template <op_t Op> static unsigned mask(const uint8_t *base, const uint32_t *starts, size_t s, int value) {
+    __m256i v = starts == nullptr
+                    ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + s * sizeof(int)))
+                    : _mm256_i32gather_epi32(reinterpret_cast<const int *>(base),
+                                             _mm256_loadu_si256(reinterpret_cast<const __m256i *>(starts + s)), 1);
+    __m256i c = _mm256_set1_epi32(value);
+    __m256i r;
+    if constexpr (Op == op_t::EQ || Op == op_t::NE) {
+      r = _mm256_cmpeq_epi32(v, c);
+    } else if constexpr (Op == op_t::LT || Op == op_t::GE) {
+      r = _mm256_cmpgt_epi32(c, v);
+    } else {
+      r = _mm256_cmpgt_epi32(v, c);
+    }
+    auto m = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(r)));
+    return Op == op_t::NE || Op == op_t::GE || Op == op_t::LE ? ~m & 0xff : m;
+  }
+};
+
+template <> struct Kernel<double> {
+  static constexpr size_t lanes = 4;
+
+  template <op_t Op> static unsigned mask(const uint8_t *base, const uint32_t *starts, size_t s, double value) {
+    __m256d v = starts == nullptr
+                    ? _mm256_loadu_pd(reinterpret_cast<const double *>(base + s * sizeof(double)))
+                    : _mm256_i32gather_pd(reinterpret_cast<const double *>(base),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(starts + s)), 1);
+    __m256d c = _mm256_set1_pd(value);
+    __m256d r;
+    if constexpr (Op == op_t::EQ) {
+      r = _mm256_cmp_pd(v, c, _CMP_EQ_OQ);
+    } else if constexpr (Op == op_t::NE) {
+      r = _mm256_cmp_pd(v, c, _CMP_NEQ_UQ);
+    } else if constexpr (Op == op_t::LT) {
+      r = _mm256_cmp_pd(v, c, _CMP_LT_OQ);
+    } else if constexpr (Op == op_t::LE) {
+      r = _mm256_cmp_pd(v, c, _CMP_LE_OQ);
+    } else if constexpr (Op == op_t::GT) {
+      r = _mm256_cmp_pd(v, c, _CMP_GT_OQ);
+    } else {
+      r = _mm256_cmp_pd(v, c, _CMP_GE_OQ);
+    }
+    return static_cast<unsigned>(_mm256_movemask_pd(r));
+  }
+};
+#elif defined(__SSE2__)
+// SSE2 has no gather: the values of the tuples are loaded one by one
+template <> struct Kernel<int> {
+  static constexpr size_t lanes = 4;
+
+  template <op_t Op> static unsigned mask(const uint8_t *base, const uint32_t *starts, size_t s, int value) {
+    __m128i v = starts == nullptr
+                    ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + s * sizeof(int)))
+                    : _mm_setr_epi32(load<int>(base + starts[s]), load<int>(base + starts[s + 1]),
+                                     load<int>(base + starts[s + 2]), load<int>(base + starts[s + 3]));
+    __m128i c = _mm_set1_epi32(value);
+    __m128i r;
+    if constexpr (Op == op_t::EQ || Op == op_t::NE) {
+      r = _mm_cmpeq_epi32(v, c);
+    } else if constexpr (Op == op_t::LT || Op == op_t::GE) {
+      r = _mm_cmplt_epi32(v, c);
+    } else {
+      r = _mm_cmpgt_epi32(v, c);
+    }
+    auto m = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(r)));
+    return Op == op_t::NE || Op == op_t::GE || Op == op_t::LE ? ~m & 0xf : m;
+  }
+};
+
+template <> struct Kernel<double> {
+  static constexpr size_t lanes = 2;
+
+  template <op_t Op> static unsigned mask(const uint8_t *base, const uint32_t *starts, size_t s, double value) {
+    __m128d v = starts == nullptr
+                    ? _mm_loadu_pd(reinterpret_cast<const double *>(base + s * sizeof(double)))
+                    : _mm_setr_pd(load<double>(base + starts[s]), load<double>(base + starts[s + 1]));
+    __m128d c = _mm_set1_pd(value);
+    __m128d r;
+    if constexpr (Op == op_t::EQ) {
+      r = _mm_cmpeq_pd(v, c);
+    } else if constexpr (Op == op_t::NE) {
+      r = _mm_cmpneq_pd(v, c);
+    } else if constexpr (Op == op_t::LT) {
+      r = _mm_cmplt_pd(v, c);
+    } else if constexpr (Op == op_t::LE) {
+      r = _mm_cmple_pd(v, c);
+    } else if constexpr (Op == op_t::GT) {
+      r = _mm_cmpgt_pd(v, c);
+    } else {
+      r = _mm_cmpge_pd(v, c);
+    }
+    return static_cast<unsigned>(_mm_movemask_pd(r));
+  }
+};
+#endif
+
+// Clears the candidate slots whose value does not compare to the constant, 64 slots at a time
+template <op_t Op, class T>
+void compare(const uint8_t *base, const uint32_t *starts, size_t slots, size_t from, T value, uint64_t *words) {
+  for (size_t w = from; w * WORD_BITS < slots; ++w) {
+    if (words[w] == 0) {
+      continue;
+    }
+    size_t first = w * WORD_BITS;
+    size_t end = std::min(first + WORD_BITS, slots);
+    size_t s = first;
+    uint64_t bits = 0;
+    if constexpr (Kernel<T>::lanes > 0) {
+      for (; s + Kernel<T>::lanes <= end; s += Kernel<T>::lanes) {
+        bits |= uint64_t{Kernel<T>::template mask<Op>(base, starts, s, value)} << (s - first);
+      }
+    }
+    // The scalar fallback, and the slots after the last full vector
+    for (; s < end; ++s) {
+      T v = load<T>(base + (starts == nullptr ? s * sizeof(T) : starts[s]));
+      bits |= uint64_t{holds<Op>(v, value)} << (s - first);
+    }
+    words[w] &= reverse(bits);
+  }
+}
+
+template <class T>
+void compare(op_t op, const uint8_t *base, const uint32_t *starts, size_t slots, size_t from, T value,
+             uint64_t *words) {
+  switch (op) {
+    case op_t::EQ:
+      return compare<op_t::EQ>(base, starts, slots, from, value, words);
+    case op_t::NE:
+      return compare<op_t::NE>(base, starts, slots, from, value, words);
+    case op_t::LT:
+      return compare<op_t::LT>(base, starts, slots, from, value, words);
+    case op_t::LE:
+      return compare<op_t::LE>(base, starts, slots, from, value, words);
+    case op_t::GT:
+      return compare<op_t::GT>(base, starts, slots, from, value, words);
+    default:
+      return compare<op_t::GE>(base, starts, slots, from, value, words);
+  }
+}
+} // namespace
+
+Predicate::Predicate(kind_t kind, std::vector<Predicate> children) : kind(kind), children(std::move(children)) {}
+
+Predicate::Predicate(size_t field, op_t op, field_t value)
+    : kind(kind_t::COMPARE), field(field), op(op), value(std::move(value)) {}
+
+Predicate Predicate::all(std::vector<Predicate> predicates) { return {kind_t::AND, std::move(predicates)}; }
+
+Predicate Predicate::any(std::vector<Predicate> predicates) { return {kind_t::OR, std::move(predicates)}; }
+
+void Predicate::check(const TupleDesc &td) const {
+  if (kind != kind_t::COMPARE) {
+    for (const Predicate &child : children) {
+      child.check(td);
+    }
+    return;
+  }
+  bool valid;
+  switch (td.field_type(field)) {
+    case type_t::INT:
+      valid = std::holds_alternative<int>(value) && op != op_t::PREFIX;
+      break;
+    case type_t::DOUBLE:
+      valid = std::holds_alternative<double>(value) && op != op_t::PREFIX;
+      break;
+    default:
+      valid = std::holds_alternative<std::string>(value) && (op == op_t::EQ || op == op_t::NE || op == op_t::PREFIX);
+      break;
+  }
+  if (!valid) {
+    throw std::logic_error("Predicate is not compatible with field " + std::to_string(field) + ".");
+  }
+}
+
+bool Predicate::matches(const TupleView &t) const {
+  switch (kind) {
+    case kind_t::AND:
+      return std::all_of(children.begin(), children.end(), [&](const Predicate &child) { return child.matches(t); });
+    case kind_t::OR:
+      return std::any_of(children.begin(), children.end(), [&](const Predicate &child) { return child.matches(t); });
+    default:
+      break;
+  }
+  switch (t.field_type(field)) {
+    case type_t::INT:
+      return holds(op, t.get_int(field), std::get<int>(value));
+    case type_t::DOUBLE:
+      return holds(op, t.get_double(field), std::get<double>(value));
+    default:
+      return holds(op, t.get_char(field), std::get<std::string>(value));
+  }
+}
+
+void Predicate::evaluate(const TupleDesc &td, const PageFields &fields, size_t from, uint64_t *words) const {
+  size_t end = (fields.slots + WORD_BITS - 1) / WORD_BITS;
+  switch (kind) {
+    case kind_t::AND:
+      // Each predicate only reads the slots that satisfy the previous ones
+      for (const Predicate &child : children) {
+        child.evaluate(td, fields, from, words);
+      }
+      return;
+    case kind_t::OR: {
+      // Each predicate only reads the slots that do not satisfy the previous ones
+      uint64_t matched[MAX_PAGE_SLOTS / WORD_BITS] = {};
+      uint64_t left[MAX_PAGE_SLOTS / WORD_BITS];
+      for (const Predicate &child : children) {
+        for (size_t w = from; w < end; ++w) {
+          left[w] = words[w] & ~matched[w];
+        }
+        child.evaluate(td, fields, from, left);
+        for (size_t w = from; w < end; ++w) {
+          matched[w] |= left[w];
+        }
+      }
+      std::copy(matched + from, matched + end, words + from);
+      return;
+    }
+    default:
+      break;
+  }
+
+  const uint8_t *base = fields.data + td.offset_of(field) * fields.scale;
+  type_t type = td.field_type(field);
+  if (type == type_t::INT) {
+    return compare(op, base, fields.starts, fields.slots, from, std::get<int>(value), words);
+  }
+  if (type == type_t::DOUBLE) {
+    return compare(op, base, fields.starts, fields.slots, from, std::get<double>(value), words);
+  }
+  // Strings are compared one candidate at a time
+  const std::string &str = std::get<std::string>(value);
+  size_t size = td.field_size(field);
+  for (size_t w = from; w < end; ++w) {
+    uint64_t bits = words[w];
+    while (bits != 0) {
+      size_t k = std::countl_zero(bits);
+      bits &= ~(FIRST_BIT >> k);
+      size_t s = w * WORD_BITS + k;
+      const uint8_t *at = base + (fields.starts == nullptr ? s * size : fields.starts[s]);
+      std::string_view chars;
+      if (type == type_t::CHAR) {
+        const char *begin = reinterpret_cast<const char *>(at);
+        const void *nul = std::memchr(begin, '\0', CHAR_SIZE);
+        chars = {begin, nul == nullptr ? CHAR_SIZE : static_cast<size_t>(static_cast<const char *>(nul) - begin)};
+      } else {
+        // The characters of a VARCHAR are located relative to the start of the tuple
+        uint16_t location[2];
+        std::memcpy(location, at, VARCHAR_SIZE);
+        chars = {reinterpret_cast<const char *>(fields.data + fields.starts[s]) + location[0], location[1]};
+      }
+      if (!holds(op, chars, str)) {
+        words[w] &= ~(FIRST_BIT >> k);
+      }
+    }
+  }
+}
@@ -0,0 +1,310 @@
+#include <db/ReplacementPolicy.hpp>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+using namespace db;
+
+namespace {
+// Returns the least recently used evictable frame of a list ordered from most to least recently used
+std::optional<size_t> lastEvictable(const std::list<size_t> &list, const std::function<bool(size_t)> &evictable) {
+  for (auto it = list.rbegin(); it != list.rend(); ++it) {
+    if (evictable(*it)) {
+      return *it;
+    }
+  }
+  return std::nullopt;
+}
+} // namespace
+
+std::unique_ptr<ReplacementPolicy> db::makeReplacementPolicy(replacement_t policy, size_t capacity) {
+  switch (policy) {
+  case replacement_t::LRU:
+    return std::make_unique<LruPolicy>(capacity);
+  case replacement_t::CLOCK:
+    return std::make_unique<ClockPolicy>(capacity);
+  case replacement_t::LRU_K:
+    return std::make_unique<LruKPolicy>(capacity);
+  case replacement_t::TWO_Q:
+    return std::make_unique<TwoQPolicy>(capacity);
+  case replacement_t::ARC:
+    return std::make_unique<ArcPolicy>(capacity);
+  }
+  throw std::logic_error("Unknown replacement policy");
+}
+
+// LRU
+
+LruPolicy::LruPolicy(size_t capacity) : links(capacity) {}
+
+void LruPolicy::link(size_t pos) {
+  links[pos] = {NIL, head};
+  if (head != NIL) {
+    links[head].prev = pos;
+  } else {
+    tail = pos;
+  }
+  head = pos;
+}
+
+void LruPolicy::unlink(size_t pos) {
+  auto [prev, next] = links[pos];
+  (prev != NIL ? links[prev].next : head) = next;
+  (next != NIL ? links[next].prev : tail) = prev;
+  links[pos] = {};
+}
+
+void LruPolicy::insert(size_t pos, const PageId &) { link(pos); }
+
+void LruPolicy::access(size_t pos) {
+  if (pos != head) {
+    unlink(pos);
+    link(pos);
+  }
+}
+
+void LruPolicy::remove(size_t pos) { unlink(pos); }
+
+size_t LruPolicy::victim(const std::function<bool(size_t)> &evictable) {
+  for (size_t pos = tail; pos != NIL; pos = links[pos].prev) {
+    if (evictable(pos)) {
+      return pos;
+    }
+  }
+  throw std::runtime_error("No frame to evict");
+}
+
+// CLOCK
+
+ClockPolicy::ClockPolicy(size_t capacity) : present(capacity), referenced(capacity) {}
+
+void ClockPolicy::insert(size_t pos, const PageId &) {
+  present[pos] = true;
+  referenced[pos] = false;
+  count++;
+}
+
+void ClockPolicy::access(size_t pos) { referenced[pos] = true; }
+
+void ClockPolicy::remove(size_t pos) {
+  present[pos] = false;
+  referenced[pos] = false;
+  count--;
+}
+
+size_t ClockPolicy::victim(const std::function<bool(size_t)> &evictable) {
+  // After one full sweep every reference bit is clear, so two sweeps find a victim unless every frame is pinned
+  for (size_t i = 0; count > 0 && i < 2 * present.size(); i++) {
+    size_t pos = hand;
+    hand = (hand + 1) % present.size();
+    if (!present[pos] || !evictable(pos)) {
+      continue;
+    }
+    if (!referenced[pos]) {
+      return pos;
+    }
+    referenced[pos] = false;
+  }
+  throw std::runtime_error("No frame to evict");
+}
+
+// LRU-K
+
+LruKPolicy::LruKPolicy(size_t capacity) : capacity(capacity), pos_to_pid(capacity), history(capacity) {
+  retained.reserve(capacity);
+}
+
+LruKPolicy::key_t LruKPolicy::key(size_t pos) const {
+  const history_t &h = history[pos];
+  // Frames with fewer than K accesses have an infinite backward K-distance and are ordered before all the others
+  if (h[K - 1] == 0) {
+    return {h[0], pos};
+  }
+  return {(uint64_t{1} << 63) | h[K - 1], pos};
+}
+
+void LruKPolicy::insert(size_t pos, const PageId &pid) {
+  history_t h{};
+  if (auto it = retained.find(pid); it != retained.end()) {
+    h = it->second.first;
+    retained_fifo.erase(it->second.second);
+    retained.erase(it);
+  }
+  std::shift_right(h.begin(), h.end(), 1);
+  h[0] = ++clock;
+  pos_to_pid[pos] = pid;
+  history[pos] = h;
+  order.insert(key(pos));
+}
+
+void LruKPolicy::access(size_t pos) {
+  // Move the node of the frame to its new place in the order: a hit does not allocate
+  auto node = order.extract(key(pos));
+  history_t &h = history[pos];
+  std::shift_right(h.begin(), h.end(), 1);
+  h[0] = ++clock;
+  node.value() = key(pos);
+  order.insert(std::move(node));
+}
+
+void LruKPolicy::remove(size_t pos) {
+  order.erase(key(pos));
+  if (retained.size() >= capacity) {
+    retained.erase(retained_fifo.front());
+    retained_fifo.pop_front();
+  }
+  const PageId &pid = pos_to_pid[pos];
+  retained_fifo.push_back(pid);
+  retained[pid] = {history[pos], std::prev(retained_fifo.end())};
+  history[pos] = {};
+}
+
+size_t LruKPolicy::victim(const std::function<bool(size_t)> &evictable) {
+  for (const auto &[distance, pos] : order) {
+    if (evictable(pos)) {
+      return pos;
+    }
+  }
+  throw std::runtime_error("No frame to evict");
+}
+
+// 2Q
+
+TwoQPolicy::TwoQPolicy(size_t capacity)
+    : kin(std::max<size_t>(1, capacity / 4)), kout(std::max<size_t>(1, capacity / 2)), pos_to_pid(capacity),
+      queue(capacity), pos_to_it(capacity) {}
+
+void TwoQPolicy::insert(size_t pos, const PageId &pid) {
+  pos_to_pid[pos] = pid;
+  if (auto it = a1out_map.find(pid); it != a1out_map.end()) {
+    // Loaded again shortly after leaving A1in: the page is hot
+    a1out.erase(it->second);
+    a1out_map.erase(it);
+    am.push_front(pos);
+    pos_to_it[pos] = am.begin();
+    queue[pos] = queue_t::AM;
+    return;
+  }
+  a1in.push_front(pos);
+  pos_to_it[pos] = a1in.begin();
+  queue[pos] = queue_t::A1IN;
+}
+
+void TwoQPolicy::access(size_t pos) {
+  // Hits in A1in are correlated references and do not change the order of the FIFO
+  if (queue[pos] == queue_t::AM) {
+    am.splice(am.begin(), am, pos_to_it[pos]);
+  }
+}
+
+void TwoQPolicy::remove(size_t pos) {
+  if (queue[pos] == queue_t::A1IN) {
+    a1in.erase(pos_to_it[pos]);
+    const PageId &pid = pos_to_pid[pos];
+    if (!a1out_map.contains(pid)) {
+      a1out.push_front(pid);
+      a1out_map[pid] = a1out.begin();
+      if (a1out.size() > kout) {
+        a1out_map.erase(a1out.back());
+        a1out.pop_back();
+      }
+    }
+  } else if (queue[pos] == queue_t::AM) {
+    am.erase(pos_to_it[pos]);
+  }
+  queue[pos] = queue_t::NONE;
+}
+
+size_t TwoQPolicy::victim(const std::function<bool(size_t)> &evictable) {
+  bool from_a1in = a1in.size() > kin || am.empty();
+  const std::list<size_t> &first = from_a1in ? a1in : am;
+  const std::list<size_t> &second = from_a1in ? am : a1in;
+  if (auto pos = lastEvictable(first, evictable)) {
+    return *pos;
+  }
+  if (auto pos = lastEvictable(second, evictable)) {
+    return *pos;
+  }
+  throw std::runtime_error("No frame to evict");
+}
+
+// ARC
+
+ArcPolicy::ArcPolicy(size_t capacity)
+    : capacity(capacity), pos_to_pid(capacity), where(capacity), pos_to_it(capacity) {}
+
+void ArcPolicy::insert(size_t pos, const PageId &pid) {
+  pos_to_pid[pos] = pid;
+  if (auto it = b1_map.find(pid); it != b1_map.end()) {
+    // A recency ghost hit: T1 was too small
+    p = std::min(capacity, p + std::max<size_t>(1, b2.size() / b1.size()));
+    b1.erase(it->second);
+    b1_map.erase(it);
+    t2.push_front(pos);
+    pos_to_it[pos] = t2.begin();
+    where[pos] = list_t::T2;
+    return;
+  }
+  if (auto it = b2_map.find(pid); it != b2_map.end()) {
+    // A frequency ghost hit: T2 was too small
+    size_t delta = std::max<size_t>(1, b1.size() / b2.size());
+    p = p > delta ? p - delta : 0;
+    b2.erase(it->second);
+    b2_map.erase(it);
+    t2.push_front(pos);
+    pos_to_it[pos] = t2.begin();
+    where[pos] = list_t::T2;
+    return;
+  }
+  t1.push_front(pos);
+  pos_to_it[pos] = t1.begin();
+  where[pos] = list_t::T1;
+}
+
+void ArcPolicy::access(size_t pos) {
+  if (where[pos] == list_t::T1) {
+    t2.splice(t2.begin(), t1, pos_to_it[pos]);
+    where[pos] = list_t::T2;
+  } else if (where[pos] == list_t::T2) {
+    t2.splice(t2.begin(), t2, pos_to_it[pos]);
+  }
+}
+
+void ArcPolicy::remove(size_t pos) {
+  const PageId &pid = pos_to_pid[pos];
+  if (where[pos] == list_t::T1) {
+    t1.erase(pos_to_it[pos]);
+    b1.push_front(pid);
+    b1_map[pid] = b1.begin();
+  } else if (where[pos] == list_t::T2) {
+    t2.erase(pos_to_it[pos]);
+    b2.push_front(pid);
+    b2_map[pid] = b2.begin();
+  }
+  where[pos] = list_t::NONE;
+
+  // Keep |T1| + |B1| <= c and the ghosts within c pages
+  while (!b1.empty() && t1.size() + b1.size() > capacity) {
+    b1_map.erase(b1.back());
+    b1.pop_back();
+  }
+  while (b1.size() + b2.size() > capacity) {
+    std::list<PageId> &ghosts = b2.empty() || b1.size() > b2.size() ? b1 : b2;
+    auto &ghosts_map = &ghosts == &b1 ? b1_map : b2_map;
+    ghosts_map.erase(ghosts.back());
+    ghosts.pop_back();
+  }
+}
+
+size_t ArcPolicy::victim(const std::function<bool(size_t)> &evictable) {
+  bool from_t1 = t1.size() > p || t2.empty();
+  const std::list<size_t> &first = from_t1 ? t1 : t2;
+  const std::list<size_t> &second = from_t1 ? t2 : t1;
+  if (auto pos = lastEvictable(first, evictable)) {
+    return *pos;
+  }
+  if (auto pos = lastEvictable(second, evictable)) {
+    return *pos;
+  }
+  throw std::runtime_error("No frame to evict");
+}
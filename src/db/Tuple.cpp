@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <db/Tuple.hpp>
 #include <stdexcept>
@@ -5,6 +6,36 @@
 
 using namespace db;
 
+namespace {
+// Decodes the field at src of the tuple serialized at data
+field_t readField(type_t type, const uint8_t *data, const uint8_t *src) {
+  switch (type) {
+    case type_t::INT: {
+      int intValue;
+      std::memcpy(&intValue, src, sizeof(int));
+      return intValue;
+    }
+    case type_t::DOUBLE: {
+      double doubleValue;
+      std::memcpy(&doubleValue, src, sizeof(double));
+      return doubleValue;
+    }
+    case type_t::CHAR: {
+      // The string ends at the first '\0', if any
+      const char *chars = reinterpret_cast<const char *>(src);
+      return std::string(chars, std::find(chars, chars + CHAR_SIZE, '\0'));
+    }
+    case type_t::VARCHAR: {
+      uint16_t location[2];
+      std::memcpy(location, src, VARCHAR_SIZE);
+      return std::string(reinterpret_cast<const char *>(data) + location[0], location[1]);
+    }
+    default:
+      throw std::runtime_error("Unsupported type in TupleDesc::deserialize.");
+  }
+}
+} // namespace
+
 Tuple::Tuple(const std::vector<field_t> &fields) : fields(fields) {}
 
 type_t Tuple::field_type(size_t i) const {
@@ -26,10 +57,14 @@ size_t Tuple::size() const { return fields.size(); }
 const field_t &Tuple::get_field(size_t i) const { return fields.at(i); }
 
 TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names)
+    : TupleDesc(types, names, std::vector<size_t>(types.size(), DEFAULT_VARCHAR_LENGTH)) {}
+
+TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names,
+                     const std::vector<size_t> &lengths)
   // TODO pa2: add initializations if needed
 {
   // TODO pa2: implement
-  if (types.size() != names.size()) {
+  if (types.size() != names.size() || types.size() != lengths.size()) {
     throw std::logic_error("Mismatched types and names length.");
   }
 
@@ -43,6 +78,33 @@ TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::st
   // Store types and names
   this->types = types;
   this->names = names;
+
+  // Lay out the fields one after the other
+  offsets.reserve(types.size());
+  this->lengths.reserve(types.size());
+  for (size_t i = 0; i < types.size(); ++i) {
+    offsets.push_back(row_length);
+    this->lengths.push_back(0);
+    switch (types[i]) {
+      case type_t::INT:
+        row_length += INT_SIZE;
+        break;
+      case type_t::DOUBLE:
+        row_length += DOUBLE_SIZE;
+        break;
+      case type_t::CHAR:
+        row_length += CHAR_SIZE;
+        break;
+      case type_t::VARCHAR:
+        if (lengths[i] == 0 || lengths[i] > DEFAULT_PAGE_SIZE) {
+          throw std::logic_error("Invalid VARCHAR length for field: " + names[i]);
+        }
+        this->lengths.back() = lengths[i];
+        row_length += VARCHAR_SIZE;
+        variable = true;
+        break;
+    }
+  }
 }
 
 bool TupleDesc::compatible(const Tuple &tuple) const {
@@ -52,6 +114,14 @@ bool TupleDesc::compatible(const Tuple &tuple) const {
   }
 
   for (size_t i = 0; i < types.size(); ++i) {
+    if (types[i] == type_t::VARCHAR) {
+      // A string of at most n characters
+      const std::string *str = std::get_if<std::string>(&tuple.get_field(i));
+      if (str == nullptr || str->size() > lengths[i]) {
+        return false;
+      }
+      continue;
+    }
     if (tuple.field_type(i) != types[i]) {
       return false;
     }
@@ -75,114 +145,107 @@ size_t TupleDesc::offset_of(const size_t &index) const {
   if (index >= types.size()) {
     throw std::out_of_range("Index out of range.");
   }
-
-  size_t offset = 0;
-  for (size_t i = 0; i < index; ++i) {
-    switch (types[i]) {
-      case type_t::INT:
-        offset += INT_SIZE;
-        break;
-      case type_t::DOUBLE:
-        offset += DOUBLE_SIZE;
-        break;
-      case type_t::CHAR:
-        offset += CHAR_SIZE;
-        break;
-    }
-  }
-  return offset;
+  return offsets[index];
 }
 
 size_t TupleDesc::length() const {
   // TODO pa2: implement
-  size_t totalLength = 0;
-  for (const auto &type : types) {
-    switch (type) {
-      case type_t::INT:
-        totalLength += INT_SIZE;
-        break;
-      case type_t::DOUBLE:
-        totalLength += DOUBLE_SIZE;
-        break;
-      case type_t::CHAR:
-        totalLength += CHAR_SIZE;
-        break;
+  return row_length;
+}
+
+size_t TupleDesc::length(const Tuple &t) const {
+  size_t total = row_length;
+  for (size_t i = 0; i < types.size() && variable; ++i) {
+    if (types[i] == type_t::VARCHAR) {
+      total += std::get<std::string>(t.get_field(i)).size();
     }
   }
-  return totalLength;
+  return total;
+}
+
+size_t TupleDesc::field_size(size_t index) const {
+  switch (types.at(index)) {
+    case type_t::INT:
+      return INT_SIZE;
+    case type_t::DOUBLE:
+      return DOUBLE_SIZE;
+    case type_t::CHAR:
+      return CHAR_SIZE;
+    default:
+      return VARCHAR_SIZE;
+  }
+}
+
+size_t TupleDesc::max_chars(size_t index) const {
+  switch (types.at(index)) {
+    case type_t::CHAR:
+      return CHAR_SIZE;
+    case type_t::VARCHAR:
+      return lengths[index];
+    default:
+      return 0;
+  }
 }
 
 size_t TupleDesc::size() const {
   // TODO pa2: implement
   return types.size();
 }
+
+type_t TupleDesc::field_type(size_t index) const { return types.at(index); }
 // Serialize a Tuple into a buffer
-void TupleDesc::serialize(uint8_t *data, const Tuple &t) const {
+size_t TupleDesc::serialize(uint8_t *data, const Tuple &t) const {
   if (!compatible(t)) {
     throw std::logic_error("Tuple is not compatible with this TupleDesc.");
   }
+  return serialize_unchecked(data, t);
+}
 
-  size_t offset = 0;
-  // Serialize each field of the Tuple into the buffer
+size_t TupleDesc::serialize_unchecked(uint8_t *data, const Tuple &t) const {
+  // Serialize each field of the Tuple into the buffer at its offset
+  size_t end = row_length;
   for (size_t i = 0; i < t.size(); ++i) {
     const field_t &field = t.get_field(i);
+    uint8_t *dest = data + offsets[i];
     switch (types[i]) {
       case type_t::INT:
-        std::memcpy(data + offset, &std::get<int>(field), sizeof(int));
-        offset += sizeof(int);
+        std::memcpy(dest, &std::get<int>(field), sizeof(int));
         break;
       case type_t::DOUBLE:
-        std::memcpy(data + offset, &std::get<double>(field), sizeof(double));
-        offset += sizeof(double);
+        std::memcpy(dest, &std::get<double>(field), sizeof(double));
         break;
       case type_t::CHAR: {
+        // Copy at most CHAR_SIZE characters and pad with '\0'
+        const std::string &str = std::get<std::string>(field);
+        size_t n = std::min(str.size(), CHAR_SIZE);
+        std::memcpy(dest, str.data(), n);
+        std::memset(dest + n, 0, CHAR_SIZE - n);
+        break;
+      }
+      case type_t::VARCHAR: {
+        // Append the characters after the fixed part
         const std::string &str = std::get<std::string>(field);
-        std::memcpy(data + offset, str.c_str(), sizeof(char) * CHAR_SIZE);
-        offset += sizeof(char) * CHAR_SIZE;
+        uint16_t location[2] = {static_cast<uint16_t>(end), static_cast<uint16_t>(str.size())};
+        std::memcpy(dest, location, VARCHAR_SIZE);
+        std::memcpy(data + end, str.data(), str.size());
+        end += str.size();
         break;
       }
     }
   }
+  return end;
 }
 Tuple TupleDesc::deserialize(const uint8_t *data) const {
   // TODO pa2: implement
   std::vector<field_t> fields;
-  size_t offset = 0;
-
-  // Deserialize each field from the buffer based on its type
-  for (const auto &type : types) {
-    switch (type) {
-      case type_t::INT: {
-        int intValue;
-        std::memcpy(&intValue, data + offset, sizeof(int));
-        fields.emplace_back(intValue);
-        offset += sizeof(int);
-        break;
-      }
-      case type_t::DOUBLE: {
-        double doubleValue;
-        std::memcpy(&doubleValue, data + offset, sizeof(double));
-        fields.emplace_back(doubleValue);
-        offset += sizeof(double);
-        break;
-      }
-      case type_t::CHAR: {
-        char charValue[CHAR_SIZE] = {};  // Initialize with zeros
-        std::memcpy(charValue, data + offset, CHAR_SIZE);
-        std::string str(charValue, CHAR_SIZE);
-
-        // Remove trailing null characters from the string
-        str.erase(std::find(str.begin(), str.end(), '\0'), str.end());
-        fields.emplace_back(str);
-        offset += CHAR_SIZE;
-        break;
-      }
-      default:
-        throw std::runtime_error("Unsupported type in TupleDesc::deserialize.");
-    }
+  fields.reserve(types.size());
+
+  // Deserialize each field from the buffer based on its type, at its offset
+  for (size_t i = 0; i < types.size(); ++i) {
+    fields.push_back(readField(types[i], data, data + offsets[i]));
   }
 
-  return Tuple(fields);  // Return a Tuple object with the deserialized fields
+  return Tuple(std::move(fields));  // Return a Tuple object with the deserialized fields
 }
 
 
@@ -192,14 +255,209 @@ db::TupleDesc TupleDesc::merge(const TupleDesc &td1, const TupleDesc &td2) {
   std::vector<type_t> mergedTypes;
   std::vector<std::string> mergedNames;
 
+  std::vector<size_t> mergedLengths;
+
   // Append all field types and names from the first TupleDesc (td1)
   mergedTypes.insert(mergedTypes.end(), td1.types.begin(), td1.types.end());
   mergedNames.insert(mergedNames.end(), td1.names.begin(), td1.names.end());
+  mergedLengths.insert(mergedLengths.end(), td1.lengths.begin(), td1.lengths.end());
 
   // Append all field types and names from the second TupleDesc (td2)
   mergedTypes.insert(mergedTypes.end(), td2.types.begin(), td2.types.end());
   mergedNames.insert(mergedNames.end(), td2.names.begin(), td2.names.end());
+  mergedLengths.insert(mergedLengths.end(), td2.lengths.begin(), td2.lengths.end());
 
   // Return a new TupleDesc object with the merged field types and names
-  return TupleDesc(mergedTypes, mergedNames);
+  return TupleDesc(mergedTypes, mergedNames, mergedLengths);
+}
+
+TupleDesc TupleDesc::project(const std::vector<size_t> &fields) const {
+  std::vector<type_t> projectedTypes;
+  std::vector<std::string> projectedNames;
+  std::vector<size_t> projectedLengths;
+  for (size_t i : fields) {
+    projectedTypes.push_back(types.at(i));
+    projectedNames.push_back(names[i]);
+    projectedLengths.push_back(types[i] == type_t::VARCHAR ? lengths[i] : DEFAULT_VARCHAR_LENGTH);
+  }
+  return TupleDesc(projectedTypes, projectedNames, projectedLengths);
+}
+
+Projection::Projection(const TupleDesc &source, const std::vector<size_t> &fields)
+    : source(&source), fields(fields), td(source.project(fields)) {
+  offsets.reserve(fields.size());
+  for (size_t i : fields) {
+    offsets.push_back(source.offset_of(i));
+  }
+}
+
+namespace {
+std::vector<size_t> indicesOf(const TupleDesc &td, const std::vector<std::string> &names) {
+  std::vector<size_t> indices;
+  indices.reserve(names.size());
+  for (const std::string &name : names) {
+    indices.push_back(td.index_of(name));
+  }
+  return indices;
+}
+} // namespace
+
+Projection::Projection(const TupleDesc &source, const std::vector<std::string> &names)
+    : Projection(source, indicesOf(source, names)) {}
+
+Tuple Projection::deserialize(const uint8_t *data) const {
+  std::vector<field_t> values;
+  values.reserve(fields.size());
+  for (size_t k = 0; k < fields.size(); ++k) {
+    values.push_back(readField(td.field_type(k), data, data + offsets[k]));
+  }
+  return Tuple(std::move(values));
+}
+
+Tuple Projection::materialize(const TupleView &view) const {
+  std::vector<field_t> values;
+  values.reserve(fields.size());
+  for (size_t k = 0; k < fields.size(); ++k) {
+    switch (td.field_type(k)) {
+      case type_t::INT:
+        values.emplace_back(view.get_int(fields[k]));
+        break;
+      case type_t::DOUBLE:
+        values.emplace_back(view.get_double(fields[k]));
+        break;
+      default:
+        values.emplace_back(std::string(view.get_char(fields[k])));
+        break;
+    }
+  }
+  return Tuple(std::move(values));
+}
+
+const uint8_t *TupleView::field(size_t i, type_t type) const {
+  if (td->field_type(i) != type) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  return data + td->offset_of(i) * capacity + td->field_size(i) * slot;
+}
+
+int TupleView::get_int(size_t i) const {
+  int value;
+  std::memcpy(&value, field(i, type_t::INT), sizeof(int));
+  return value;
+}
+
+double TupleView::get_double(size_t i) const {
+  double value;
+  std::memcpy(&value, field(i, type_t::DOUBLE), sizeof(double));
+  return value;
+}
+
+std::string_view TupleView::get_char(size_t i) const {
+  if (td->field_type(i) == type_t::VARCHAR) {
+    uint16_t location[2];
+    std::memcpy(location, data + td->offset_of(i), VARCHAR_SIZE);
+    return {reinterpret_cast<const char *>(data) + location[0], location[1]};
+  }
+  const char *chars = reinterpret_cast<const char *>(field(i, type_t::CHAR));
+  const void *end = std::memchr(chars, '\0', CHAR_SIZE);
+  return {chars, end == nullptr ? CHAR_SIZE : static_cast<size_t>(static_cast<const char *>(end) - chars)};
+}
+
+size_t TupleView::length() const {
+  size_t total = td->length();
+  for (size_t i = 0; i < td->size() && !td->fixed_length(); ++i) {
+    if (td->field_type(i) == type_t::VARCHAR) {
+      total += get_char(i).size();
+    }
+  }
+  return total;
+}
+
+void TupleView::serialize(uint8_t *out) const {
+  if (capacity == 1) {
+    // The characters of the VARCHAR fields follow the fixed part
+    std::memcpy(out, data, length());
+    return;
+  }
+  // Gather the fields into a row
+  for (size_t i = 0; i < td->size(); ++i) {
+    size_t size = td->field_size(i);
+    std::memcpy(out + td->offset_of(i), data + td->offset_of(i) * capacity + size * slot, size);
+  }
+}
+
+Tuple TupleView::materialize() const {
+  if (capacity == 1) {
+    return td->deserialize(data);
+  }
+  std::vector<uint8_t> row(td->length());
+  serialize(row.data());
+  return td->deserialize(row.data());
+}
+
+FlatTuple::FlatTuple(const TupleDesc &td, const Tuple &t, allocator_type alloc) : td(&td), data(alloc) {
+  if (!td.compatible(t)) {
+    throw std::logic_error("Tuple is not compatible with this TupleDesc.");
+  }
+  data.resize(td.length(t));
+  td.serialize(data.data(), t);
+}
+
+FlatTuple::FlatTuple(const TupleView &view, allocator_type alloc) : td(&view.getTupleDesc()), data(alloc) {
+  data.resize(view.length());
+  view.serialize(data.data());
+}
+
+size_t FlatTuple::size() const { return td->size(); }
+
+type_t FlatTuple::field_type(size_t i) const { return td->field_type(i); }
+
+void FlatTuple::set_int(size_t i, int value) {
+  if (td->field_type(i) != type_t::INT) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  std::memcpy(data.data() + td->offset_of(i), &value, sizeof(int));
+}
+
+void FlatTuple::set_double(size_t i, double value) {
+  if (td->field_type(i) != type_t::DOUBLE) {
+    throw std::logic_error("Field " + std::to_string(i) + " has another type.");
+  }
+  std::memcpy(data.data() + td->offset_of(i), &value, sizeof(double));
+}
+
+void FlatTuple::set_char(size_t i, std::string_view value) {
+  uint8_t *dest = data.data() + td->offset_of(i);
+  if (td->field_type(i) == type_t::CHAR) {
+    size_t n = std::min(value.size(), CHAR_SIZE);
+    std::memcpy(dest, value.data(), n);
+    std::memset(dest + n, 0, CHAR_SIZE - n);
+    return;
+  }
+  if (td->field_type(i) != type_t::VARCHAR || value.size() > td->max_chars(i)) {
+    throw std::logic_error("Value is not compatible with field " + std::to_string(i) + ".");
+  }
+  // Replace the characters in place, and move the locations of the characters that follow them
+  uint16_t location[2];
+  std::memcpy(location, dest, VARCHAR_SIZE);
+  size_t start = location[0];
+  size_t old = location[1];
+  if (value.size() > old) {
+    data.insert(data.begin() + start + old, value.size() - old, 0);
+  } else {
+    data.erase(data.begin() + start + value.size(), data.begin() + start + old);
+  }
+  std::memcpy(data.data() + start, value.data(), value.size());
+  for (size_t j = 0; j < td->size(); ++j) {
+    if (td->field_type(j) != type_t::VARCHAR) {
+      continue;
+    }
+    std::memcpy(location, data.data() + td->offset_of(j), VARCHAR_SIZE);
+    if (j == i) {
+      location[1] = static_cast<uint16_t>(value.size());
+    } else if (location[0] > start) {
+      location[0] = static_cast<uint16_t>(location[0] + value.size() - old);
+    }
+    std::memcpy(data.data() + td->offset_of(j), location, VARCHAR_SIZE);
+  }
 }
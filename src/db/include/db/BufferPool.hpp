@@ -1,34 +1,400 @@
 #pragma once
 
+#include <db/FrameArena.hpp>
+#include <db/FrameTable.hpp>
+#include <db/ReplacementPolicy.hpp>
 #include <db/types.hpp>
-#include <list>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace db {
 constexpr size_t DEFAULT_NUM_PAGES = 50;
+constexpr size_t DEFAULT_RING_SIZE = 16;
+constexpr size_t MIN_SHARD_PAGES = 8;
+constexpr size_t INITIAL_READAHEAD = 4;
+constexpr size_t DEFAULT_SCAN_RUN = 8;
+constexpr std::chrono::milliseconds WRITER_INTERVAL{10};
+
+/**
+ * @brief How a page is being accessed.
+ * @details NORMAL accesses are tracked by the replacement policy. SEQUENTIAL accesses come from a scan: the pages they
+ * load are recycled through a small ring of frames per file and scanning thread, and their hits do not make a page look
+ * hot.
+ */
+enum class access_t { NORMAL, SEQUENTIAL };
+
+/**
+ * @brief Configuration of a BufferPool.
+ * @details The capacity of the pool can be given either as a number of pages or as a memory budget in bytes. By
+ * default the pool has one shard per hardware thread, as long as every shard has at least MIN_SHARD_PAGES frames.
+ */
+struct BufferPoolOptions {
+  size_t num_pages = DEFAULT_NUM_PAGES;
+  replacement_t policy = replacement_t::LRU;
+  size_t ring_size = DEFAULT_RING_SIZE; // frames a sequential scan may recycle, 0 disables the rings
+  size_t num_shards = 0;                 // independently locked partitions of the pool, 0 picks them automatically
+  size_t readahead = 0;                  // maximum number of pages prefetched ahead of a scan, 0 disables it
+  double clean_fraction = 0;             // fraction of frames the background writer keeps clean, 0 disables it
+  bool huge_pages = false;               // back the frames with huge pages
+  size_t scan_run = DEFAULT_SCAN_RUN;    // pages a scan miss reads with one vectored read, 0 or 1 reads one page
+
+  /**
+   * @brief Returns the options of a pool that fits in the specified number of bytes.
+   * @param bytes The memory budget of the pool frames.
+   * @return The options with num_pages set to the number of whole pages that fit in the budget.
+   */
+  static BufferPoolOptions fromBytes(size_t bytes) { return {bytes / DEFAULT_PAGE_SIZE}; }
+};
+
+/**
+ * @brief Counters of a BufferPool.
+ */
+struct BufferPoolStats {
+  size_t hits = 0;            // requests for a resident page
+  size_t misses = 0;          // requests that had to read the page
+  size_t prefetched = 0;      // pages read ahead of a scan
+  size_t prefetch_hits = 0;   // prefetched pages that were requested before being evicted
+  size_t prefetch_unused = 0; // prefetched pages that were evicted or discarded without being requested
+  size_t background_writes = 0; // dirty pages written by the background writer
+};
+
+class BufferPool;
+
+/**
+ * @brief A pin on a page of a BufferPool.
+ * @details A PageGuard keeps its page pinned: the BufferPool never evicts a pinned page, so the page can be used for as
+ * long as the guard lives without looking it up again. The pin is released when the guard is destroyed, released or
+ * assigned to.
+ * @note Guards are movable but not copyable. Use ReadPageGuard or WritePageGuard to obtain one.
+ */
+class PageGuard {
+protected:
+  BufferPool *pool = nullptr;
+  PageId pid;
+  size_t pos = 0;
+  Page *page = nullptr;
+
+  PageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page);
+
+  /**
+   * @brief Releases the pin, marking the page dirty first if requested.
+   */
+  void unpin(bool dirty);
+
+public:
+  PageGuard() = default;
+
+  PageGuard(const PageGuard &) = delete;
+
+  PageGuard(PageGuard &&other) noexcept;
+
+  PageGuard &operator=(const PageGuard &) = delete;
+
+  PageGuard &operator=(PageGuard &&other) noexcept;
+
+  ~PageGuard();
+
+  /**
+   * @brief Returns the page id of the guarded page.
+   */
+  const PageId &getPageId() const { return pid; }
+
+  /**
+   * @brief Returns whether the guard holds a page.
+   */
+  explicit operator bool() const { return pool != nullptr; }
+
+  /**
+   * @brief Returns the metadata cached with the frame of the page, see setMeta.
+   * @return The last value stored since the page was loaded, 0 if none was.
+   */
+  uint64_t getMeta() const;
+
+  /**
+   * @brief Caches metadata derived from the page with its frame, e.g. the slot counts of a HeapPage.
+   * @param meta A non-zero value; the BufferPool does not interpret it.
+   * @note The metadata is reset to 0 when the page is loaded into a frame, evicted or marked dirty with markDirty.
+   * A writer that changes the page through a WritePageGuard must store the new metadata or 0 before releasing it.
+   */
+  void setMeta(uint64_t meta) const;
+};
+
+/**
+ * @brief A pinned page with a shared latch.
+ * @details Several threads may read the same page at the same time; writers wait until every reader is done.
+ */
+class ReadPageGuard : public PageGuard {
+  friend class BufferPool;
+
+  std::shared_lock<std::shared_mutex> latch;
+
+  ReadPageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page, std::shared_mutex &latch);
+
+public:
+  ReadPageGuard() = default;
+
+  ReadPageGuard(ReadPageGuard &&) noexcept = default;
+
+  ReadPageGuard &operator=(ReadPageGuard &&other) noexcept;
+
+  ~ReadPageGuard();
+
+  const Page &operator*() const { return *page; }
+
+  const Page *operator->() const { return page; }
+
+  /**
+   * @brief Releases the latch and the pin. The guard no longer holds a page.
+   */
+  void release();
+};
+
+/**
+ * @brief A pinned page with an exclusive latch.
+ * @details Releasing a WritePageGuard marks its page dirty.
+ */
+class WritePageGuard : public PageGuard {
+  friend class BufferPool;
+
+  std::unique_lock<std::shared_mutex> latch;
+
+  WritePageGuard(BufferPool *pool, const PageId &pid, size_t pos, Page *page, std::shared_mutex &latch);
+
+public:
+  WritePageGuard() = default;
+
+  WritePageGuard(WritePageGuard &&) noexcept = default;
+
+  WritePageGuard &operator=(WritePageGuard &&other) noexcept;
+
+  ~WritePageGuard();
+
+  Page &operator*() const { return *page; }
+
+  Page *operator->() const { return page; }
+
+  /**
+   * @brief Releases the latch and marks the page dirty before releasing the pin. The guard no longer holds a page.
+   */
+  void release();
+};
+
+/**
+ * @brief A pinned page without a latch.
+ * @details A PinnedPage keeps its page in its frame, so pointers into the page stay valid for as long as it lives, but
+ * it does not keep other threads from changing the page: use it to read pages that no other thread writes, or take a
+ * ReadPageGuard. Unlike the latched guards, it can be copied; each copy holds a pin of its own.
+ */
+class PinnedPage : public PageGuard {
+  friend class BufferPool;
+
+  PinnedPage(BufferPool *pool, const PageId &pid, size_t pos, Page *page) : PageGuard(pool, pid, pos, page) {}
+
+public:
+  PinnedPage() = default;
+
+  PinnedPage(const PinnedPage &other);
+
+  PinnedPage(PinnedPage &&) noexcept = default;
+
+  PinnedPage &operator=(const PinnedPage &other);
+
+  PinnedPage &operator=(PinnedPage &&) noexcept = default;
+
+  const Page &operator*() const { return *page; }
+
+  const Page *operator->() const { return page; }
+
+  /**
+   * @brief Releases the pin. The guard no longer holds a page.
+   */
+  void release() { unpin(false); }
+};
+
 /**
  * @brief Represents a buffer pool for database pages.
  * @details The BufferPool class is responsible for managing the database pages in memory.
  * It provides functions to get a page, mark a page as dirty, and check the status of pages.
  * The class also supports flushing pages to disk and discarding pages from the buffer pool.
- * @note A BufferPool owns the Page objects that are stored in it.
+ * @note A BufferPool owns the Page objects that are stored in it. All pages live in a single FrameArena.
+ * @note All methods are thread-safe. The frames are partitioned into shards by the hash of their PageId; each shard
+ * has its own lock, replacement policy and scan rings, so threads working on different shards do not contend.
+ * Each frame also has a shared/exclusive latch that is held exclusively while a page is loaded into or evicted from
+ * the frame and shared while the page is written to disk. ReadPageGuard and WritePageGuard hold it while a caller uses
+ * the page. Reads and writes run without the shard lock: a page is tracked as soon as its frame is reserved, pinned and
+ * latched by the thread that reads it, and the other requests for it wait on the latch. A dirty victim is written
+ * before it is evicted, with the shard lock released as well.
+ * @note Frames with a non-zero pin count are never evicted.
+ * @note The state of every frame (page id, dirty bit, pin count) lives in a cache-line-aligned descriptor array, and
+ * each shard finds the frame of a page with a flat FrameTable: a hit is one probe plus one descriptor, and neither
+ * hits nor single-page misses allocate.
+ * @note Each frame also holds a 64-bit word of metadata for the file format (see PageGuard::setMeta), so that what is
+ * derived from a page is not recomputed every time the page is fetched.
+ * @note Without readahead, a SEQUENTIAL miss also faults in the missing pages among the next scan_run pages of the
+ * file that belong to the same shard (at most a ring of them, or a quarter of the shard), reading each contiguous run
+ * with one vectored read.
+ * @note With readahead enabled, a background thread prefetches the pages that follow a run of consecutive page
+ * requests of a file. The window starts at INITIAL_READAHEAD pages, doubles (up to readahead) every time a prefetched
+ * page is requested and halves every time one is evicted unused.
+ * @note With clean_fraction enabled, a background writer wakes up every WRITER_INTERVAL (or when an eviction had to
+ * write a dirty page) and writes dirty pages until that fraction of every shard is clean. Eviction then prefers clean
+ * frames. The writer, flushFile and the destructor sort the pages they write by (file, page) and write each run of
+ * contiguous pages with a single vectored write.
  */
 class BufferPool {
-  std::array<Page, DEFAULT_NUM_PAGES> pages;
-  std::array<PageId, DEFAULT_NUM_PAGES> pos_to_pid;
-  std::unordered_map<const PageId, size_t> pid_to_pos;
-  std::unordered_set<size_t> dirty;
-  std::vector<size_t> available;
-  std::list<size_t> lru_list;
-  std::unordered_map<size_t, std::list<size_t>::iterator> pos_to_lru;
+  friend class PageGuard;
+  friend class PinnedPage;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    size_t first = 0; // position of the first frame of the shard
+    size_t size = 0;  // number of frames of the shard
+    FrameTable pid_to_pos;
+    size_t num_dirty = 0;
+    std::vector<size_t> available;
+    std::unique_ptr<ReplacementPolicy> policy; // tracks frames by their position within the shard
+    size_t ring_size = 0;
+    uint64_t next_ring_tag = 0;
+    // The (frame, ring tag) entries of each scan, by file and scanning thread, so that concurrent scans of a file do
+    // not recycle each other's frames. The rings of a file are dropped with its pages in discardFile
+    std::unordered_map<file_id_t, std::unordered_map<std::thread::id, std::deque<std::pair<size_t, uint64_t>>>> rings;
+  };
+
+  // The descriptor of a frame, guarded by the lock of the frame's shard. Each descriptor has a cache line of its own
+  // so that a hit touches a single line and threads working on different shards never share one
+  struct alignas(64) Frame {
+    PageId pid;            // INVALID_FILE_ID if the frame is free
+    uint64_t ring_tag = 0; // 0 if the frame is not part of a ring
+    uint32_t pins = 0;
+    bool dirty = false;
+    bool prefetched = false;
+    bool loading = false; // the page is being read by the thread that holds the latch
+  };
+
+  FrameArena pages;
+  std::unique_ptr<std::shared_mutex[]> latches;
+  // Metadata cached by the users of each frame, written and read under the latch of the frame
+  std::unique_ptr<std::atomic<uint64_t>[]> metas;
+  std::vector<Frame> frames;
+  size_t num_shards;
+  std::unique_ptr<Shard[]> shards;
+
+  struct ReadAhead {
+    size_t last = 0;   // last page requested
+    size_t next = 0;   // first page that has not been scheduled for prefetching
+    size_t window = 0; // pages to keep scheduled ahead of the last page
+  };
+
+  size_t readahead;
+  size_t scan_run;
+  std::mutex readahead_mutex; // guards readaheads, prefetch_queue and stopping
+  std::unordered_map<file_id_t, ReadAhead> readaheads;
+  std::deque<std::pair<PageId, access_t>> prefetch_queue;
+  std::condition_variable prefetch_cv;
+  bool stopping = false;
+  std::thread prefetcher;
+
+  std::atomic<size_t> hits = 0;
+  std::atomic<size_t> misses = 0;
+  std::atomic<size_t> prefetches = 0;
+  std::atomic<size_t> prefetch_hits = 0;
+  std::atomic<size_t> prefetch_unused = 0;
+  std::atomic<size_t> background_writes = 0;
+
+  double clean_fraction;
+  std::mutex writer_mutex; // guards writer_stopping
+  std::condition_variable writer_cv;
+  bool writer_stopping = false;
+  std::thread writer;
+
+  Shard &shardOf(const PageId &pid) const;
+
+  size_t resident(const Shard &shard, const PageId &pid) const;
+
+  /**
+   * @brief Returns the frame of a page, pinned, reading the page if it is not resident.
+   * @param lock The lock of the shard. It is released while the page is read or a victim is written.
+   */
+  size_t fetch(Shard &shard, std::unique_lock<std::mutex> &lock, const PageId &pid, access_t access);
+
+  /**
+   * @brief Tracks a page in a free frame before it is read: the frame is pinned and latched exclusively until
+   * finishLoad, so that the requests for the page wait for it.
+   */
+  void reserve(Shard &shard, size_t pos, const PageId &pid, bool ring, bool prefetching);
+
+  /**
+   * @brief Releases the latch of a reserved frame. If the page could not be read, it is no longer tracked and the frame
+   * returns to the shard once it is unpinned.
+   */
+  void finishLoad(Shard &shard, size_t pos, bool read);
+
+  void track(Shard &shard, size_t pos, const PageId &pid, bool ring);
+
+  void scheduleReadAhead(const PageId &pid, access_t access);
+
+  void prefetchLoop();
+
+  void prefetch(std::vector<std::pair<PageId, access_t>> &batch);
+
+  void loadBatch(Shard &shard, std::unique_lock<std::mutex> &lock,
+                 const std::vector<std::pair<PageId, access_t>> &batch, bool prefetching);
+
+  bool claim(Shard &shard, size_t pos);
+
+  /**
+   * @brief Writes claimed frames and releases them; the pages of a failed write become dirty again.
+   * @param background Whether the pages written are counted as background writes.
+   */
+  void writeClaimed(std::vector<size_t> &claimed, bool background = false);
+
+  bool writeBack(const std::function<bool(const PageId &)> &select);
+
+  void writerLoop();
+
+  void cleanShard(Shard &shard);
+
+  size_t pin(const PageId &pid, access_t access);
+
+  void unpin(const PageId &pid, size_t pos, bool dirty);
+
+  void repin(const PageId &pid, size_t pos);
+
+  void release(Shard &shard, size_t pos);
+
+  /**
+   * @brief Returns a free frame of the shard, evicting a victim if needed.
+   * @return The frame, or FrameTable::npos if the lock was released to write a dirty victim: the caller must then look
+   * at the shard again.
+   */
+  size_t freeFrame(Shard &shard, std::unique_lock<std::mutex> &lock);
+
+  size_t ringFrame(Shard &shard, std::unique_lock<std::mutex> &lock, file_id_t file);
+
+  void writeVictim(Shard &shard, std::unique_lock<std::mutex> &lock, size_t pos);
+
+  void evict(Shard &shard, size_t pos);
+
+  void discardFrame(Shard &shard, size_t pos);
+
+  void setDirty(Shard &shard, size_t pos, bool dirty);
 
 public:
   /**
-   * @brief: Constructs a BufferPool object with the default number of pages.
+   * @brief: Constructs a BufferPool object with the specified capacity.
+   * @param options: The configuration of the pool.
+   * @throws std::logic_error if the pool has no pages or fewer pages than shards.
    */
-  explicit BufferPool();
+  explicit BufferPool(const BufferPoolOptions &options = {});
 
   /**
    * @brief: Destructs a BufferPool object after flushing all dirty pages to disk.
@@ -43,17 +409,81 @@ public:
 
   BufferPool &operator=(BufferPool &&) = delete;
 
+  /**
+   * @brief: Returns the number of pages the buffer pool can hold.
+   */
+  size_t capacity() const;
+
+  /**
+   * @brief: Returns the number of shards of the buffer pool.
+   */
+  size_t getNumShards() const { return num_shards; }
+
+  /**
+   * @brief: Returns a snapshot of the counters of the buffer pool.
+   */
+  BufferPoolStats getStats() const;
+
   /**
    * @brief: Returns the page with the specified page id.
    * @param pid: The page id of the page to return.
+   * @param access: How the page is accessed. Sequential scans should pass access_t::SEQUENTIAL.
    * @return: The page with the specified page id.
-   * @note This method should make this page the most recently used page.
+   * @note A NORMAL access is reported to the replacement policy (e.g. the page becomes the most recently used page).
+   * @note A SEQUENTIAL miss loads the page into the ring of its file and of the calling thread, evicting the oldest
+   * page of the ring once it holds ring_size pages.
+   * @note The returned reference stays valid until the page is evicted, which another thread may do at any time.
+   * Use fetchRead or fetchWrite to keep the page pinned.
+   */
+  Page &getPage(const PageId &pid, access_t access = access_t::NORMAL);
+
+  /**
+   * @brief: Pins the page with the specified page id and latches it for reading.
+   * @param pid: The page id of the page to return.
+   * @param access: How the page is accessed, see getPage.
+   * @return: A guard that keeps the page pinned and latched until it is released.
+   * @throws std::runtime_error if the page is not resident and every frame of its shard is pinned.
+   */
+  ReadPageGuard fetchRead(const PageId &pid, access_t access = access_t::NORMAL);
+
+  /**
+   * @brief: Pins the page with the specified page id and latches it for writing.
+   * @param pid: The page id of the page to return.
+   * @param access: How the page is accessed, see getPage.
+   * @return: A guard that keeps the page pinned and latched until it is released. Releasing it marks the page dirty.
+   * @throws std::runtime_error if the page is not resident and every frame of its shard is pinned.
+   */
+  WritePageGuard fetchWrite(const PageId &pid, access_t access = access_t::NORMAL);
+
+  /**
+   * @brief: Pins the page with the specified page id without latching it.
+   * @param pid: The page id of the page to return.
+   * @param access: How the page is accessed, see getPage.
+   * @return: A guard that keeps the page pinned until it is released.
+   * @throws std::runtime_error if the page is not resident and every frame of its shard is pinned.
    */
-  Page &getPage(const PageId &pid);
+  PinnedPage fetchPinned(const PageId &pid, access_t access = access_t::NORMAL);
+
+  /**
+   * @brief: Creates a zero-filled page in the buffer pool without reading it from disk, pinned and latched for writing.
+   * @param pid: The page id of the new page, e.g. a page appended with DbFile::appendPage.
+   * @return The guard of the page. The page is dirty: it is written to disk when it is flushed or evicted.
+   * @throws std::logic_error if the page is already in the buffer pool.
+   * @throws std::runtime_error if every frame is pinned.
+   */
+  WritePageGuard newPage(const PageId &pid);
+
+  /**
+   * @brief: Returns whether the page with the specified page id is pinned.
+   * @param pid: The page id of the page to check.
+   * @return: True if the page is resident and pinned by at least one guard, false otherwise.
+   */
+  bool isPinned(const PageId &pid) const;
 
   /**
    * @brief: Marks the page with the specified page id as dirty.
    * @param pid: The page id of the page to mark as dirty.
+   * @note The metadata cached with the page is reset: the page may have been changed through getPage.
    */
   void markDirty(const PageId &pid);
 
@@ -76,20 +506,41 @@ public:
    * @param pid: The page id of the page to discard.
    * @note This method does NOT flush the page to disk.
    * @note This method also updates the LRU and dirty pages to exclude tracking this page.
+   * @throws std::logic_error if the page is pinned.
    */
   void discardPage(const PageId &pid);
 
+  /**
+   * @brief: Discards every page of the specified file from the buffer pool, e.g. before the file is removed.
+   * @param file: The id of the associated file.
+   * @note This method does NOT flush the pages to disk.
+   * @throws std::logic_error if a page of the file is pinned or dirty. The other pages are discarded.
+   */
+  void discardFile(file_id_t file);
+
   /**
    * @brief: Flushes the page with the specified page id to disk.
    * @param pid: The page id of the page to flush.
+   * @return: True if the page is clean, false if it was skipped.
    * @note This method should remove the page from dirty pages.
+   * @note A page that is latched for writing is skipped: it stays dirty until a later flush or eviction.
    */
-  void flushPage(const PageId &pid);
+  bool flushPage(const PageId &pid);
   /**
    * @brief: Flushes all dirty pages in the specified file to disk.
-   * @param file: The name of the associated file.
+   * @param file: The id of the associated file.
+   * @return: True if every page of the file is clean, false if pages latched for writing were skipped.
+   * @throws std::out_of_range if the Database has no file with this id.
    * @note This method should call BufferPool::flushPage(pid).
+   * @note Once every dirty page of the file has been written, an MMAP file reads its pages in place again.
+   */
+  bool flushFile(file_id_t file);
+  /**
+   * @brief: Flushes all dirty pages in the specified file to disk.
+   * @param file: The name of the associated file.
+   * @return: True if every page of the file is clean, false if pages latched for writing were skipped.
+   * @throws std::out_of_range if the Database has no file with this name.
    */
-  void flushFile(const std::string &file);
+  bool flushFile(const std::string &file);
 };
 } // namespace db
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace db {
+constexpr size_t DEFAULT_CHUNK_SIZE = 1024;
+
+/**
+ * @brief A batch of tuples stored column by column, filled by DbFile::scan.
+ * @details Each field has an array of capacity() values, the value of row r at index r: an INT field holds ints, a
+ * DOUBLE field doubles, a CHAR field CHAR_SIZE bytes padded with '\0', and a VARCHAR field the (offset, length) of its
+ * characters in a buffer of the chunk, as two uint32_t. The selection vector lists the rows that are part of the
+ * result, in increasing order: every row once the chunk is filled, fewer once filter() drops some. A chunk built from a
+ * Projection only has the arrays of the projected fields: a scan does not copy the other fields.
+ * @note The chunk holds copies of the fields: it stays valid when the pages are evicted. Its arrays are allocated once,
+ * so that a chunk reused from one scan call to the next does not allocate.
+ */
+class Chunk {
+  const TupleDesc *td;
+  const TupleDesc *source;     // the tuple descriptor of the scanned tuples
+  std::vector<size_t> fields;  // the field of the source of each array
+  size_t max_rows;
+  size_t rows = 0;
+  std::vector<size_t> widths;                // bytes per value of each array
+  std::vector<std::vector<uint8_t>> columns; // one array per field
+  std::vector<char> chars;                   // the characters of the VARCHAR fields
+  std::vector<uint32_t> selected;            // the selection vector
+
+  void allocate();
+
+public:
+  /**
+   * @brief Creates an empty chunk.
+   * @param td The tuple descriptor of the tuples. The chunk must not outlive it.
+   * @param capacity The maximum number of rows.
+   * @throws std::logic_error if the capacity is 0.
+   */
+  explicit Chunk(const TupleDesc &td, size_t capacity = DEFAULT_CHUNK_SIZE);
+
+  /**
+   * @brief Creates an empty chunk of some fields of the tuples.
+   * @param projection The fields, with the tuple descriptor of the tuples. The chunk must not outlive it.
+   * @param capacity The maximum number of rows.
+   * @throws std::logic_error if the capacity is 0.
+   */
+  explicit Chunk(const Projection &projection, size_t capacity = DEFAULT_CHUNK_SIZE);
+
+  /**
+   * @brief Returns the tuple descriptor of the rows: the projected one if the chunk was built from a Projection.
+   */
+  const TupleDesc &getTupleDesc() const { return *td; }
+
+  /**
+   * @brief Returns the tuple descriptor of the scanned tuples.
+   */
+  const TupleDesc &getSource() const { return *source; }
+
+  /**
+   * @brief Returns the field of the scanned tuples that the array of field i holds.
+   */
+  size_t field(size_t i) const { return fields.at(i); }
+
+  /**
+   * @brief Returns the maximum number of rows.
+   */
+  size_t capacity() const { return max_rows; }
+
+  /**
+   * @brief Returns the number of rows, selected or not.
+   */
+  size_t size() const { return rows; }
+
+  bool full() const { return rows == capacity(); }
+
+  /**
+   * @brief Removes every row, keeping the arrays.
+   */
+  void clear();
+
+  /**
+   * @brief Returns the number of bytes of each value of the array of a field.
+   * @throws std::out_of_range if the index is out of range.
+   */
+  size_t width(size_t i) const { return widths.at(i); }
+
+  /**
+   * @brief Returns the array of a field, to be written before the rows are added with append().
+   * @throws std::out_of_range if the index is out of range.
+   */
+  uint8_t *column(size_t i) { return columns.at(i).data(); }
+
+  const uint8_t *column(size_t i) const { return columns.at(i).data(); }
+
+  /**
+   * @brief Returns the array of an INT field.
+   * @throws std::out_of_range if the index is out of range.
+   * @throws std::logic_error if the field is not an INT.
+   */
+  const int *ints(size_t i) const;
+
+  /**
+   * @brief Returns the array of a DOUBLE field.
+   * @throws std::out_of_range if the index is out of range.
+   * @throws std::logic_error if the field is not a DOUBLE.
+   */
+  const double *doubles(size_t i) const;
+
+  /**
+   * @brief Returns the characters of a CHAR or VARCHAR field of a row, which point into the chunk.
+   * @throws std::out_of_range if the index is out of range.
+   * @throws std::logic_error if the field is not a CHAR or a VARCHAR.
+   */
+  std::string_view get_char(size_t i, size_t row) const;
+
+  /**
+   * @brief Copies the characters of a VARCHAR field of a row into the chunk.
+   * @throws std::logic_error if the field is not a VARCHAR.
+   */
+  void setVarchar(size_t i, size_t row, std::string_view value);
+
+  /**
+   * @brief Adds the rows whose fields have been written to the arrays, and selects them.
+   * @param count The number of rows, after the current ones.
+   * @throws std::out_of_range if the chunk cannot hold them.
+   */
+  void append(size_t count);
+
+  /**
+   * @brief Returns the selected rows, in increasing order.
+   */
+  std::span<const uint32_t> selection() const { return selected; }
+
+  /**
+   * @brief Drops the selected rows for which keep(row) is false.
+   */
+  template <class Keep> void filter(Keep keep) {
+    size_t kept = 0;
+    for (uint32_t row : selected) {
+      selected[kept] = row;
+      kept += keep(row) ? 1 : 0;
+    }
+    selected.resize(kept);
+  }
+
+  /**
+   * @brief Copies the fields of a row into a Tuple.
+   * @throws std::out_of_range if the row is out of range.
+   */
+  Tuple materialize(size_t row) const;
+};
+} // namespace db
@@ -2,8 +2,20 @@
 
 #include <db/BufferPool.hpp>
 #include <db/DbFile.hpp>
+#include <db/IoBackend.hpp>
+#include <array>
+#include <atomic>
 #include <memory>
 
+namespace db {
+/**
+ * @brief Configuration of a Database.
+ */
+struct DatabaseOptions {
+  BufferPoolOptions buffer_pool;
+  io_backend_t io_backend = io_backend_t::SYNC; // falls back to SYNC when io_uring is not available
+};
+
 /**
  * @brief A database is a collection of files and a BufferPool.
  * @details The Database class is responsible for managing the database files.
@@ -11,16 +23,25 @@
  * The class also supports removing all files from the catalog.
  * @note A Database owns the DbFile objects that are added to it.
  */
-namespace db {
 class Database {
+  static constexpr size_t ID_CHUNK = 1024; // ids per chunk of the id table
+  static constexpr size_t ID_CHUNKS = 1024;
+
   std::unordered_map<std::string, std::unique_ptr<DbFile>> files;
+  // The files by id, nullptr once removed. The table grows one chunk at a time and chunks never move, so the prefetcher
+  // and the background writer look files up without a lock while add() appends: num_ids is stored after the entry
+  std::array<std::unique_ptr<std::atomic<DbFile *>[]>, ID_CHUNKS> ids;
+  std::atomic<size_t> num_ids = 0;
+
+  std::unique_ptr<IoBackend> ioBackend;
 
   BufferPool bufferPool;
 
-  Database() = default;
+  explicit Database(const DatabaseOptions &options);
 
 public:
   friend Database &getDatabase();
+  friend Database &initDatabase(const DatabaseOptions &options);
 
   Database(Database const &) = delete;
   void operator=(Database const &) = delete;
@@ -33,11 +54,19 @@ public:
    */
   BufferPool &getBufferPool();
 
+  /**
+   * @brief Provides access to the backend that performs the batched I/O of the BufferPool.
+   * @return The I/O backend
+   */
+  IoBackend &getIoBackend();
+
   /**
    * @brief Adds a new file to the Database.
    * @param file The file to add.
    * @throws std::logic_error if the file name already exists.
-   * @note This method takes ownership of the DbFile.
+   * @throws std::length_error if every file id has been assigned.
+   * @note This method takes ownership of the DbFile and assigns it the next file id.
+   * Ids are never reused, so pages of a removed file that linger in the BufferPool cannot alias a new file.
    */
   void add(std::unique_ptr<DbFile> file);
 
@@ -46,7 +75,9 @@ public:
    * @param name The name of the file to remove.
    * @return The removed file.
    * @throws std::logic_error if the name does not exist.
-   * @note This method should call BufferPool::flushFile(name)
+   * @throws std::logic_error if a page of the file is in use (pinned or latched). The file is not removed then.
+   * @note This method should call BufferPool::flushFile(id)
+   * @note The pages of the file are discarded from the BufferPool once they have been written.
    * @note This method moves the DbFile ownership to the caller.
    */
   std::unique_ptr<DbFile> remove(const std::string &name);
@@ -58,6 +89,15 @@ public:
    * @throws std::logic_error if the name does not exist.
    */
   DbFile &get(const std::string &name) const;
+
+  /**
+   * @brief Returns the DbFile of the specified id.
+   * @param id The id of the file.
+   * @return The DbFile object.
+   * @throws std::out_of_range if the id does not exist.
+   * @note This method may be called while another thread adds a file.
+   */
+  DbFile &get(file_id_t id) const;
 };
 
 /**
@@ -65,4 +105,13 @@ public:
  * @return The Database object.
  */
 Database &getDatabase();
+
+/**
+ * @brief Creates the singleton instance of the Database with the specified options.
+ * @param options The configuration of the Database (e.g. the capacity of its BufferPool).
+ * @return The Database object.
+ * @throws std::logic_error if the Database has already been created.
+ * @note Without a call to this function, getDatabase() creates the Database with the default options.
+ */
+Database &initDatabase(const DatabaseOptions &options);
 } // namespace db
@@ -1,10 +1,29 @@
 #pragma once
 
+#include <db/BufferPool.hpp>
+#include <db/IoBackend.hpp>
 #include <db/Iterator.hpp>
 #include <db/types.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <vector>
 
 namespace db {
+class Chunk;
+class Predicate;
+
+constexpr size_t DEFAULT_EXTENT_PAGES = 16;
+
+/**
+ * @brief How a DbFile accesses its file.
+ * @details BUFFERED goes through the kernel page cache. DIRECT opens the file with O_DIRECT so that pages are only
+ * cached by the BufferPool; its frames are aligned to DEFAULT_PAGE_SIZE, other pages go through an aligned copy.
+ * MMAP also maps the file read-only so that reads use the pages in place, without copying them into the BufferPool.
+ * Writes go through the BufferPool and switch the reads back to it until the file is flushed.
+ */
+enum class file_mode_t { BUFFERED, DIRECT, MMAP };
 
 /**
  * @brief Represents a database file.
@@ -13,27 +32,69 @@ namespace db {
  * @note A `DbFile` object owns the `TupleDesc` object that describes the schema of the tuples in the file.
  */
 class DbFile {
+  mutable std::mutex io_mutex; // guards reads and writes
   mutable std::vector<size_t> reads;
   mutable std::vector<size_t> writes;
 
   // TODO pa2: add private member for file handler
   int fileDescriptor;  // Add this line
+  file_mode_t mode;
+  size_t extent;    // pages reserved on disk at a time
+  size_t allocated; // pages reserved on disk, including the ones that have not been written yet
+
+  // A read-only mapping of the file, with room for the file to grow
+  struct Mapping {
+    const Page *pages;
+    size_t capacity; // in pages
+  };
+
+  std::mutex map_mutex; // guards mappings
+  // The current mapping is the last one. Older mappings stay valid until the file is destroyed: readers may still use
+  // their pages
+  std::vector<std::unique_ptr<Mapping>> mappings;
+  std::atomic<const Mapping *> mapping = nullptr;
+  std::atomic<bool> mapped = false; // whether reads may use the mapping
+  std::atomic<uint64_t> write_epoch = 0;
+
+  friend class Database;
 
 protected:
   const std::string name;
+  file_id_t id = INVALID_FILE_ID; // assigned by Database::add
   const TupleDesc td;
-  size_t numPages;
+  // Read by the prefetcher and the background writer while pages are appended: a page is only counted once it is in
+  // the BufferPool
+  std::atomic<size_t> numPages;
+  bool created = false; // whether the file was empty when it was opened
+
+  /**
+   * @brief Appends a page to the file without writing it: the page is created in the BufferPool with
+   * BufferPool::newPage and is counted in getNumPages() once it is there.
+   * @return The guard of the new page.
+   * @note Disk space is reserved one extent at a time with fallocate(FALLOC_FL_KEEP_SIZE); the file only grows on
+   * disk when the page is written.
+   */
+  WritePageGuard appendPage();
+
+  /**
+   * @brief Announces a write through the BufferPool: reads stop using the mapping until remap().
+   */
+  void beginWrite();
 
 public:
   /**
    * @brief Construct a new Db File object with the specified file name and tuple descriptor
    * @param name of the file to be opened or created.
    * @param td tuple description of tuples in the file.
+   * @param mode how the file is accessed.
+   * @param extent the number of pages reserved on disk whenever the file needs more space.
    * @throws std::runtime_error if the file cannot be opened or if the `fstat` system call fails.
    * @note This method calculates the number of pages in the file by dividing the file size (in bytes)
    * by the `DEFAULT_PAGE_SIZE`.
+   * @note If the file system does not support O_DIRECT, a DIRECT file falls back to BUFFERED.
    */
-  explicit DbFile(const std::string &name, const TupleDesc &td);
+  explicit DbFile(const std::string &name, const TupleDesc &td, file_mode_t mode = file_mode_t::BUFFERED,
+                  size_t extent = DEFAULT_EXTENT_PAGES);
 
   /**
    * @brief closes the file descriptor.
@@ -42,6 +103,17 @@ public:
 
   const std::string &getName() const;
 
+  /**
+   * @brief Returns how the file is accessed, after any fallback.
+   */
+  file_mode_t getMode() const { return mode; }
+
+  /**
+   * @brief Returns the id assigned to the file by Database::add.
+   * @return The file id, or INVALID_FILE_ID if the file has not been added to the Database.
+   */
+  file_id_t getId() const { return id; }
+
   const std::vector<size_t> &getReads() const;
 
   const std::vector<size_t> &getWrites() const;
@@ -61,14 +133,115 @@ public:
    */
   void writePage(const Page &page, size_t id) const;
 
+  /**
+   * @brief Read a run of contiguous pages from the file with vectored reads.
+   * @param first The page number of the first page. It determines the offset in the file.
+   * @param count The number of pages to read.
+   * @param frames The pages to read into; page first + i is read into frames[i].
+   * @throws std::out_of_range if the run goes past the last page of the file.
+   * @note Each page is accounted for in getReads().
+   */
+  void readPages(size_t first, size_t count, Page *const *frames) const;
+
+  /**
+   * @brief Write a run of contiguous pages to the file with vectored writes.
+   * @param first The page number of the first page. It determines the offset in the file.
+   * @param count The number of pages to write.
+   * @param frames The pages to write; frames[i] is written to page first + i.
+   * @note Each page is accounted for in getWrites().
+   */
+  void writePages(size_t first, size_t count, const Page *const *frames) const;
+
+  /**
+   * @brief Describes a vectored read or write of a run of contiguous pages, to be performed by an IoBackend.
+   * @param write Whether the pages are written or read.
+   * @param first The page number of the first page. It determines the offset in the file.
+   * @param iov One buffer of DEFAULT_PAGE_SIZE bytes per page; it must outlive the request.
+   * @param count The number of pages.
+   * @return The request. Its outcome is checked with complete().
+   * @throws std::out_of_range if the run goes past the last page of the file.
+   * @throws std::logic_error if the file is DIRECT and a buffer is not aligned to DEFAULT_PAGE_SIZE.
+   * @note Each page is accounted for in getReads() or getWrites().
+   */
+  IoRequest request(bool write, size_t first, iovec *iov, size_t count) const;
+
+  /**
+   * @brief Checks the outcome of a request returned by request() once an IoBackend has performed it.
+   * @param request The request.
+   * @throws std::runtime_error if the request failed.
+   */
+  void complete(const IoRequest &request) const;
+
+  /**
+   * @brief Returns a page of an MMAP file in place.
+   * @param id The page number.
+   * @return The page, or nullptr if it has to be read through the BufferPool: the file is not MMAP, has pending writes,
+   * or the page is past the end of the file.
+   * @note The page stays valid as long as the file.
+   */
+  const Page *mappedPage(size_t id) const;
+
+  /**
+   * @brief Advises the kernel that the mapping is about to be scanned (MADV_SEQUENTIAL and MADV_WILLNEED).
+   */
+  void adviseScan() const;
+
+  /**
+   * @brief Returns a counter of the writes announced with beginWrite().
+   */
+  uint64_t getWriteEpoch() const { return write_epoch; }
+
+  /**
+   * @brief Lets reads use the mapping again once the writes have been flushed, growing the mapping if needed.
+   * @param epoch The write epoch read before the flush started. Nothing changes if a write began since.
+   * @note BufferPool::flushFile calls this method after it has written every dirty page of the file.
+   */
+  void remap(uint64_t epoch);
+
   virtual void insertTuple(const Tuple &t);
 
+  /**
+   * @brief Inserts tuples, in order.
+   * @details The default inserts them one at a time with insertTuple.
+   */
+  virtual void insertTuples(std::span<const Tuple> tuples);
+
+  /**
+   * @brief Inserts tuples serialized by TupleDesc::serialize, one after the other.
+   */
+  virtual void insertRows(std::span<const uint8_t> rows);
+
   virtual void deleteTuple(const Iterator &it);
 
   virtual Tuple getTuple(const Iterator &it) const;
 
+  /**
+   * @brief Returns some fields of a tuple, only decoding them.
+   * @param it The iterator that identifies the tuple.
+   * @param projection The fields, built from the tuple descriptor of the file.
+   * @return A Tuple of the projected TupleDesc.
+   */
+  virtual Tuple getTuple(const Iterator &it, const Projection &projection) const;
+
+  /**
+   * @brief Returns a view of a tuple that reads its fields from the page, without copying them.
+   * @param it The iterator that identifies the tuple. It keeps the page of the view pinned.
+   * @return The view. It stays valid until the iterator is destroyed or used for a view of another page.
+   */
+  virtual TupleView getTupleView(const Iterator &it) const;
+
   virtual void next(Iterator &it) const;
 
+  /**
+   * @brief Fills a chunk with the next tuples of a scan.
+   * @param it Where the scan resumes; it does not have to point to a tuple. It is moved past the tuples of the chunk,
+   * to end() once the file has been read.
+   * @param chunk The chunk, with the tuple descriptor of the file. Its rows are replaced.
+   * @param predicate The tuples to return, or nullptr to return every tuple.
+   * @return The number of tuples in the chunk, 0 once the file has been read.
+   */
+  virtual size_t scan(Iterator &it, Chunk &chunk, const Predicate *predicate = nullptr) const;
+
   virtual Iterator begin() const;
 
   virtual Iterator end() const;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <db/types.hpp>
+
+namespace db {
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+/**
+ * @brief A contiguous, page-aligned block of frames.
+ * @details The FrameArena class allocates all the frames of a BufferPool with a single allocation so that a pool of any
+ * size is one contiguous region of memory aligned to DEFAULT_PAGE_SIZE.
+ * @note The frames are not zero-initialized; a frame is expected to be filled before it is read.
+ * @note An arena backed by huge pages is rounded up to a multiple of HUGE_PAGE_SIZE. It uses MAP_HUGETLB when huge
+ * pages are reserved and otherwise falls back to a HUGE_PAGE_SIZE-aligned mapping advised with MADV_HUGEPAGE.
+ */
+class FrameArena {
+  Page *frames;
+  size_t capacity;
+  size_t mapped = 0; // bytes mapped with mmap, 0 if the frames were allocated with operator new
+  bool hugetlb = false;
+
+public:
+  /**
+   * @brief Allocates an arena of the specified number of frames.
+   * @param capacity The number of frames.
+   * @param huge_pages Whether to back the frames with huge pages, which cuts the TLB misses of a large arena.
+   * @throws std::bad_alloc if the arena cannot be allocated.
+   */
+  explicit FrameArena(size_t capacity, bool huge_pages = false);
+
+  /**
+   * @brief Releases the arena.
+   */
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+
+  FrameArena(FrameArena &&) = delete;
+
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  FrameArena &operator=(FrameArena &&) = delete;
+
+  Page &operator[](size_t pos) { return frames[pos]; }
+
+  const Page &operator[](size_t pos) const { return frames[pos]; }
+
+  /**
+   * @brief Returns the number of frames in the arena.
+   */
+  size_t size() const { return capacity; }
+
+  /**
+   * @brief Returns whether the arena is backed by reserved (MAP_HUGETLB) huge pages.
+   */
+  bool usesHugetlb() const { return hugetlb; }
+};
+} // namespace db
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <vector>
+
+namespace db {
+/**
+ * @brief Maps the page ids of the resident pages of a BufferPool shard to the positions of their frames.
+ * @details The FrameTable class is a flat open-addressing hash table with linear probing. It is sized once for the
+ * number of frames of the shard (at most half full), so a lookup is usually a single probe into one contiguous array
+ * and neither insert nor erase ever allocates. Erase shifts the following entries back instead of leaving tombstones.
+ * @note The table uses the high bits of the hash: the shard of a page is picked with the low bits.
+ */
+class FrameTable {
+  struct Slot {
+    PageId pid; // INVALID_FILE_ID if the slot is empty
+    size_t pos = 0;
+  };
+
+  std::vector<Slot> slots;
+  size_t shift = 0;
+  size_t count = 0;
+
+  size_t home(const PageId &pid) const;
+
+  size_t locate(const PageId &pid) const;
+
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  FrameTable() = default;
+
+  /**
+   * @brief Creates an empty table for the specified number of frames.
+   * @param capacity The maximum number of entries.
+   */
+  explicit FrameTable(size_t capacity);
+
+  /**
+   * @brief Returns the position of the frame that holds a page.
+   * @param pid The page id.
+   * @return The position, or npos if the page is not in the table.
+   */
+  size_t find(const PageId &pid) const;
+
+  bool contains(const PageId &pid) const { return find(pid) != npos; }
+
+  /**
+   * @brief Adds a page to the table.
+   * @param pid The page id, which must not be in the table.
+   * @param pos The position of its frame.
+   * @throws std::logic_error if the table already holds as many entries as its capacity.
+   */
+  void insert(const PageId &pid, size_t pos);
+
+  /**
+   * @brief Removes a page from the table, if present.
+   * @param pid The page id.
+   */
+  void erase(const PageId &pid);
+
+  size_t size() const { return count; }
+};
+} // namespace db
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace db {
+/**
+ * @brief Tracks which pages of a HeapFile have a free slot.
+ * @details The map is a bitmap with one bit per page, most significant bit first like the HeapPage header. The pages
+ * whose bit is set are also kept on a stack so that find() does not scan the bitmap: inserts fill the page on top of
+ * the stack, deletes push the page they free a slot in.
+ * @note The map is persisted in a side file, next to the heap file, when the file is closed. The side file is removed
+ * when it is loaded, so a map that was not saved after the last changes to the file is never trusted.
+ */
+class FreeSpaceMap {
+  std::string path;
+  std::vector<uint8_t> bits; // bit i is set iff page i has a free slot
+  size_t pages = 0;
+  std::vector<size_t> candidates; // every page whose bit is set, possibly followed by pages whose bit was cleared
+
+public:
+  /**
+   * @brief Creates an empty map.
+   * @param path The side file in which the map is persisted.
+   */
+  explicit FreeSpaceMap(std::string path);
+
+  /**
+   * @brief Loads the map from its side file and removes the file.
+   * @param numPages The number of pages of the heap file.
+   * @return Whether the side file was found and describes a file of numPages pages. If not, the map is empty and the
+   * caller rebuilds it with set().
+   */
+  bool load(size_t numPages);
+
+  /**
+   * @brief Writes the map to its side file.
+   * @throws std::runtime_error if the side file cannot be written.
+   */
+  void save() const;
+
+  /**
+   * @brief Returns the number of pages tracked by the map.
+   */
+  size_t size() const { return pages; }
+
+  /**
+   * @brief Returns whether a page has a free slot.
+   * @param page The page number. Pages past the end of the map have no free slot.
+   */
+  bool hasRoom(size_t page) const;
+
+  /**
+   * @brief Records whether a page has a free slot, growing the map if needed.
+   * @param page The page number.
+   * @param room Whether the page has a free slot.
+   */
+  void set(size_t page, bool room);
+
+  /**
+   * @brief Returns a page with a free slot, in amortized O(1) time.
+   * @return The page most recently given room, or std::nullopt if every page is full.
+   */
+  std::optional<size_t> find();
+};
+} // namespace db
@@ -1,22 +1,93 @@
 #pragma once
 
+#include <db/BufferPool.hpp>
 #include <db/DbFile.hpp>
+#include <db/FreeSpaceMap.hpp>
+#include <db/HeapPage.hpp>
+#include <optional>
 
 namespace db {
 class HeapFile : public DbFile {
+  FreeSpaceMap fsm;
+  HeapPageLayout layout;
+
+  /**
+   * @brief Returns a page for reading: in place if the file is mapped, otherwise pinned in the BufferPool.
+   * @param page The page number.
+   * @param access How the page is accessed.
+   * @param guard Holds the page while it is used when it comes from the BufferPool.
+   * @return The page, wrapped with the metadata cached with its frame (which is filled in if it was missing).
+   */
+  HeapPage fetchPage(size_t page, access_t access, std::optional<ReadPageGuard> &guard) const;
+
+  /**
+   * @brief Fills pages with a batch, fetching each page once: the pages the free space map reports to have room, then
+   * new pages.
+   * @param total The size of the batch.
+   * @param insert Inserts the batch from an offset into a page, and returns how much of it was inserted.
+   */
+  template <class Insert> void fillPages(size_t total, Insert insert);
+
 public:
-  HeapFile(const std::string &name, const TupleDesc &td);
+  /**
+   * @brief Opens or creates a heap file.
+   * @details The free space map is loaded from the side file `<name>.fsm`. If the side file is missing or stale, the
+   * map is rebuilt from the pages of the file. The page layout of a new file is recorded in the side file
+   * `<name>.layout`; an existing file keeps the layout it was created with, ROW if none was recorded.
+   * @param pageLayout How the tuples of a new file are stored.
+   * @throws std::logic_error if pageLayout is PAX and td has VARCHAR fields.
+   * @throws std::runtime_error if the layout cannot be recorded or read.
+   */
+  HeapFile(const std::string &name, const TupleDesc &td, file_mode_t mode = file_mode_t::BUFFERED,
+           size_t extent = DEFAULT_EXTENT_PAGES, page_layout_t pageLayout = page_layout_t::ROW);
+
+  /**
+   * @brief Returns how the tuples of the file are stored.
+   */
+  page_layout_t getPageLayout() const;
+
+  /**
+   * @brief Returns the layout of the pages of the file.
+   */
+  const HeapPageLayout &getLayout() const { return layout; }
+
+  /**
+   * @brief Saves the free space map to its side file.
+   */
+  ~HeapFile() override;
 
   /**
    * @brief Insert a tuple to the database file.
-   * @details Insert a tuple to the first available slot of the last page. If the last page is full, create a new page.
+   * @details Insert a tuple to the first available slot of a page that the free space map reports to have room, without
+   * scanning the file. If every page is full, create a new page. With VARCHAR fields, the pages are slotted and a page
+   * that cannot fit the tuple leaves the free space map until a tuple is deleted from it. The new page is appended with
+   * appendPage() and built in the BufferPool; it reaches the disk when it is flushed.
    * @param t The tuple to be inserted.
    */
   void insertTuple(const Tuple &t) override;
 
+  /**
+   * @brief Insert tuples to the database file.
+   * @details The tuples are checked against the TupleDesc once, before any of them is inserted. Each page that the free
+   * space map reports to have room is then fetched once and its free slots are filled in one pass, and new pages are
+   * appended once those are full: the BufferPool is looked up once per page instead of once per tuple.
+   * @param tuples The tuples, inserted in order.
+   * @throws std::logic_error if a tuple is not compatible with the TupleDesc. No tuple is inserted then.
+   */
+  void insertTuples(std::span<const Tuple> tuples) override;
+
+  /**
+   * @brief Insert serialized tuples to the database file, like insertTuples.
+   * @details The bytes of each tuple are copied to its slot as they are, without building a Tuple.
+   * @param rows Tuples serialized by TupleDesc::serialize (or TupleView::serialize), one after the other.
+   * @throws std::logic_error if the bytes are not whole serialized tuples of the TupleDesc. No tuple is inserted then.
+   */
+  void insertRows(std::span<const uint8_t> rows) override;
+
   /**
    * @brief Delete a tuple from the database file.
-   * @details Delete a tuple from the database file by marking the slot unused.
+   * @details Delete a tuple from the database file by marking the slot unused. The page is recorded in the free space
+   * map so that the slot is reused by the next inserts.
    * @param it The iterator that identifies the tuple to be deleted.
    */
   void deleteTuple(const Iterator &it) override;
@@ -29,19 +100,60 @@ public:
    */
   Tuple getTuple(const Iterator &it) const override;
 
+  /**
+   * @brief Get some fields of a tuple from the database file.
+   * @details Only the projected fields are decoded, at the offsets computed when the projection was built.
+   * @param it The iterator that identifies the tuple to be read.
+   * @param projection The fields, built from the tuple descriptor of the file.
+   * @return A Tuple of the projected TupleDesc.
+   * @throws std::logic_error if the projection was built from a tuple descriptor with other fields.
+   */
+  Tuple getTuple(const Iterator &it, const Projection &projection) const override;
+
+  /**
+   * @brief Get a view of a tuple from the database file.
+   * @details The view reads the fields from the page in place: a mapped page of an MMAP file, otherwise the page
+   * pinned by the iterator in the BufferPool, which is only looked up again when the iterator has moved to another
+   * page.
+   * @param it The iterator that identifies the tuple to be read.
+   * @return The view of the tuple.
+   * @throws std::logic_error if the slot is empty.
+   * @note The page is pinned but not latched: the view must not be used while another thread writes the page.
+   */
+  TupleView getTupleView(const Iterator &it) const override;
+
   /**
    * @brief Advance the iterator to the next tuple.
    * @details Advance the iterator to the next tuple by moving to the next slot of the page.
    * @param it The iterator to be advanced.
    * @note The next tuple may be on a subsequent page (pages might be empty).
+   * @note Pages are fetched with access_t::SEQUENTIAL so that a scan does not evict the hot pages of the pool.
+   * @note Pages of an MMAP file without pending writes are read in place.
    */
   void next(Iterator &it) const override;
 
+  /**
+   * @brief Fills a chunk with the next tuples of a scan.
+   * @details Each page is fetched once per chunk, and its tuples are copied to the arrays of the chunk field by field:
+   * there is no virtual call, lookup in the BufferPool or HeapPage construction per tuple.
+   * @param it Where the scan resumes; it does not have to point to a tuple. It is moved past the tuples of the chunk,
+   * to end() once the file has been read.
+   * @param chunk The chunk. Its rows are replaced.
+   * @param predicate The tuples to return, or nullptr to return every tuple. It is evaluated on the bytes of each page,
+   * with SIMD comparisons where possible, so that only the tuples that satisfy it are copied to the chunk.
+   * @return The number of tuples in the chunk, 0 once the file has been read.
+   * @throws std::logic_error if the chunk does not have the fields of the file.
+   * @throws std::logic_error if the predicate does not apply to the fields of the file.
+   * @note Pages are fetched with access_t::SEQUENTIAL, or read in place if the file is mapped.
+   */
+  size_t scan(Iterator &it, Chunk &chunk, const Predicate *predicate = nullptr) const override;
+
   /**
    * @brief Get the iterator to the first tuple.
    * @details Get the iterator to the first tuple by finding the first occupied slot.
    * @return The iterator to the first tuple.
    * @note The first tuple may not be on the first page.
+   * @note For an MMAP file, the kernel is advised that the file is about to be scanned.
    */
   Iterator begin() const override;
 
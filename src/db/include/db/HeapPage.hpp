@@ -1,14 +1,110 @@
 #pragma once
 
+#include <db/Chunk.hpp>
 #include <db/DbFile.hpp>
+#include <db/Predicate.hpp>
 
 namespace db {
+/**
+ * @brief How the tuples of a heap page are stored.
+ * @details ROW stores each tuple in one piece. PAX stores the slots column by column: the header bitmap is followed by
+ * one array per field, so that a scan of a few fields only reads their arrays. PAX requires tuples of a fixed length.
+ */
+enum class page_layout_t { ROW, PAX };
+
+/**
+ * @brief The layout of the heap pages of a file.
+ * @details It only depends on the TupleDesc of the file, so a HeapFile computes it once instead of every time it wraps
+ * a page. Tuples of a fixed length are stored in an array of slots with an occupancy bitmap. Tuples with VARCHAR fields
+ * are stored in slotted pages: a directory of (offset, length) slots after a (slot count, heap start) header, and the
+ * tuples packed at the end of the page. A PAX page has as many slots as a ROW page, but field i of every slot is
+ * stored in an array of capacity values, at data + capacity * td.offset_of(i).
+ */
+struct HeapPageLayout {
+  size_t length;   // bytes per tuple, the minimum for a slotted page
+  size_t capacity; // slots per page, unless the page is slotted
+  size_t data;     // offset of the tuple (or the first array) of the first slot, after the header and the padding
+  bool slotted;    // whether the pages are slotted
+  bool pax;        // whether the slots are stored column by column
+
+  /**
+   * @brief Computes the layout of the pages of a TupleDesc.
+   * @param td The tuple descriptor of the pages.
+   * @param kind How the tuples are stored.
+   * @throws std::logic_error if the pages are slotted and the longest tuple does not fit in a page.
+   * @throws std::logic_error if the pages are PAX and the tuples do not have a fixed length.
+   */
+  explicit HeapPageLayout(const TupleDesc &td, page_layout_t kind = page_layout_t::ROW);
+
+  /**
+   * @brief Returns a view of the tuple in a slot of a page, without wrapping the page with a HeapPage.
+   * @param page The page.
+   * @param td The tuple descriptor the layout was computed from.
+   * @param slot The slot.
+   * @throws std::runtime_error if the slot is out of range.
+   * @throws std::logic_error if the slot is empty.
+   */
+  TupleView view(const Page &page, const TupleDesc &td, size_t slot) const;
+
+  /**
+   * @brief Returns the array of the values of a field in a PAX page.
+   * @param page The page.
+   * @param td The tuple descriptor the layout was computed from.
+   * @param i The index of the field.
+   * @return capacity values of td.field_size(i) bytes, the one of slot s first at s * td.field_size(i). The values of
+   * the empty slots are unspecified.
+   * @throws std::logic_error if the pages are not PAX.
+   */
+  const uint8_t *column(const Page &page, const TupleDesc &td, size_t i) const;
+};
+
+/**
+ * @brief Wraps a page of a HeapFile.
+ * @details The page is laid out as described by HeapPageLayout. In a slotted page, the end of the slots is the size of
+ * the directory: it grows when a tuple is inserted and every slot is in use, and the empty slots at its end are
+ * dropped. The slot of a tuple never changes, but deleting a tuple moves the tuples stored before it so that the free
+ * space stays contiguous. The number of tuples a slotted page holds depends on the length of their VARCHAR fields.
+ */
 class HeapPage {
   const TupleDesc &td;
-  size_t capacity;
+  size_t capacity; // the end of the slots
+  size_t length;
   uint8_t *header;
   uint8_t *data;
   size_t count;
+  size_t hint; // every slot before it is occupied
+  bool slotted;
+  bool pax;
+
+  /**
+   * @brief Returns the (offset, length) of the tuple in a slot of a slotted page; the length is 0 if the slot is empty.
+   */
+  std::pair<size_t, size_t> entry(size_t slot) const;
+
+  void setEntry(size_t slot, size_t offset, size_t size);
+
+  /**
+   * @brief Returns the bytes between the slot directory and the tuples of a slotted page.
+   */
+  size_t freeSpace() const;
+
+  /**
+   * @brief Returns 64 slots of the header as a word, slot 64 * w first in the most significant bit.
+   * @details The header bytes are read as a big-endian word, so the bit order is the one of the page. The bits of
+   * the slots past the capacity are cleared.
+   */
+  uint64_t word(size_t w) const;
+
+  /**
+   * @brief Returns the first occupied (or free) slot at or after a slot, capacity if there is none.
+   */
+  size_t find(size_t from, bool used) const;
+
+  /**
+   * @brief Inserts the tuples of a source to the free slots, in order, until the page is full or the source is empty.
+   * @return The number of tuples inserted.
+   */
+  template <class Source> size_t fill(Source &source);
 
 public:
   /**
@@ -21,6 +117,34 @@ public:
    */
   HeapPage(Page &page, const TupleDesc &td);
 
+  /**
+   * @brief Wrap a read-only page with a heap page.
+   * @details Used with pages obtained through a ReadPageGuard. Only the const methods may be called on the result,
+   * which is why it should be declared as a `const HeapPage`.
+   * @param page The page to be wrapped.
+   * @param td The tuple descriptor of the page.
+   */
+  HeapPage(const Page &page, const TupleDesc &td) : HeapPage(const_cast<Page &>(page), td) {}
+
+  /**
+   * @brief Wrap a page with a heap page of a known layout.
+   * @param page The page to be wrapped.
+   * @param td The tuple descriptor of the page.
+   * @param layout The layout of the pages of td.
+   * @param meta The value of meta() for this page, or 0 if it is not known: the occupied slots are then counted.
+   */
+  HeapPage(Page &page, const TupleDesc &td, const HeapPageLayout &layout, uint64_t meta = 0);
+
+  HeapPage(const Page &page, const TupleDesc &td, const HeapPageLayout &layout, uint64_t meta = 0)
+      : HeapPage(const_cast<Page &>(page), td, layout, meta) {}
+
+  /**
+   * @brief Returns the number of occupied slots and the first slot that may be free, packed into a non-zero word.
+   * @details The word can be cached with the frame of the page (see PageGuard::setMeta) while the page is unchanged,
+   * and passed back to the constructor so that it does not count the slots again.
+   */
+  uint64_t meta() const;
+
   /**
    * @brief Get the first occupied slot of the page.
    * @return The first occupied slot of the page.
@@ -33,6 +157,12 @@ public:
    */
   size_t end() const;
 
+  /**
+   * @brief Check if every slot of the page is occupied.
+   * @return True if the page has no free slot, false otherwise.
+   */
+  bool full() const;
+
   /**
    * @brief Insert a tuple to the page.
    * @details Insert a tuple to the page by serializing the tuple to the page.
@@ -41,6 +171,22 @@ public:
    */
   bool insertTuple(const Tuple &t);
 
+  /**
+   * @brief Insert tuples to the free slots of the page, in order.
+   * @details The free slots are found in one pass over the header. The tuples are serialized without being checked:
+   * the caller checks the whole batch once.
+   * @param tuples Tuples compatible with the tuple descriptor of the page.
+   * @return The number of tuples inserted: all of them, or the ones before the first that does not fit in the page.
+   */
+  size_t insertTuples(std::span<const Tuple> tuples);
+
+  /**
+   * @brief Insert serialized tuples to the free slots of the page, in order, copying their bytes as they are.
+   * @param rows Tuples serialized by TupleDesc::serialize, one after the other. They are not checked.
+   * @return The number of bytes of the tuples inserted.
+   */
+  size_t insertRows(std::span<const uint8_t> rows);
+
   /**
    * @brief Delete a tuple from the page.
    * @details Delete a tuple from the page by marking the slot unused.
@@ -64,10 +210,29 @@ public:
    */
   Tuple getTuple(size_t slot) const;
 
+  /**
+   * @brief Get some fields of the tuple at the specified slot.
+   * @param slot The slot of the tuple.
+   * @param projection The fields, built from the tuple descriptor of the page.
+   * @return A Tuple of the projected TupleDesc.
+   * @throws std::runtime_error if the slot is out of range.
+   * @throws std::logic_error if the slot is empty.
+   */
+  Tuple getTuple(size_t slot, const Projection &projection) const;
+
   /**
    * @brief Advance the slot to the next occupied slot.
    * @details Advance the slot to the next occupied slot by scanning the header.
    */
   void next(size_t &slot) const;
+
+  /**
+   * @brief Appends the tuples of the page to a chunk, field by field.
+   * @param slot The slot to start from. It does not have to be occupied.
+   * @param chunk The chunk, with the tuple descriptor of the page. The tuples are added after its rows.
+   * @param predicate The tuples to append, evaluated on the bytes of the page, or nullptr to append every tuple.
+   * @return The first slot to append that did not fit in the chunk, or end() if every tuple was appended.
+   */
+  size_t scan(size_t slot, Chunk &chunk, const Predicate *predicate = nullptr) const;
 };
 } // namespace db
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace db {
+enum class io_backend_t { SYNC, IO_URING };
+
+/**
+ * @brief A vectored read or write of a file region.
+ * @details The buffers are filled (or written) in order starting at offset. Once the request has been performed,
+ * result holds the number of bytes transferred or, if the request failed, a negative errno.
+ */
+struct IoRequest {
+  int fd = -1;
+  bool write = false;
+  size_t offset = 0;
+  iovec *iov = nullptr;
+  size_t iovcnt = 0;
+  ssize_t result = 0;
+
+  /**
+   * @brief Returns the total number of bytes of the buffers.
+   */
+  size_t length() const;
+};
+
+/**
+ * @brief Completes a request with blocking preadv/pwritev calls.
+ * @param request The request. The transfer resumes after the first request.result bytes.
+ * @note Partial transfers are resumed until the whole request is done or a call fails.
+ */
+void transfer(IoRequest &request);
+
+/**
+ * @brief Performs batches of file reads and writes.
+ * @details An IoBackend takes a batch of requests, possibly to different files, and returns once every request of the
+ * batch has completed. A backend that supports asynchronous I/O keeps the whole batch in flight at once.
+ * @note Backends are thread-safe.
+ */
+class IoBackend {
+public:
+  virtual ~IoBackend() = default;
+
+  /**
+   * @brief Returns the kind of the backend.
+   */
+  virtual io_backend_t kind() const = 0;
+
+  /**
+   * @brief Performs a batch of requests and waits for all of them.
+   * @param requests The requests. The result of each request is set, a failed request does not affect the others.
+   * @note Every request is either done in full or failed: partial transfers are resumed.
+   */
+  virtual void submit(std::span<IoRequest> requests) = 0;
+};
+
+/**
+ * @brief Performs the requests one after the other with blocking system calls.
+ */
+class SyncIoBackend : public IoBackend {
+public:
+  io_backend_t kind() const override { return io_backend_t::SYNC; }
+
+  void submit(std::span<IoRequest> requests) override;
+};
+
+/**
+ * @brief Submits each batch to an io_uring and reaps the completions, keeping up to a ring of requests in flight.
+ * @details submit() only returns once the kernel is done with every buffer of the batch. If io_uring_enter fails, the
+ * requests the kernel has not taken are withdrawn and fail with its errno, and the ones in flight are still waited for.
+ * @note The ring is driven with the raw io_uring_setup and io_uring_enter system calls; the rings are shared with the
+ * kernel through mmap.
+ */
+class IoUringBackend : public IoBackend {
+  std::mutex mutex; // guards the rings
+  int ring_fd = -1;
+  unsigned entries = 0;
+
+  void *sq_ring = nullptr;
+  size_t sq_ring_size = 0;
+  void *cq_ring = nullptr;
+  size_t cq_ring_size = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqes_size = 0;
+
+  unsigned *sq_tail = nullptr;
+  unsigned sq_mask = 0;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe *cqes = nullptr;
+  uint32_t batch = 0; // tags the user_data of the requests of each chunk, so that stray completions are recognized
+
+  void submitChunk(std::span<IoRequest> requests);
+
+protected:
+  /**
+   * @brief Calls io_uring_enter on the ring.
+   * @return The number of requests submitted, or -1 with errno set.
+   * @note Tests override it to inject failures.
+   */
+  virtual int enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+
+public:
+  /**
+   * @brief Sets up an io_uring.
+   * @param entries The maximum number of requests in flight.
+   * @throws std::runtime_error if io_uring is not available.
+   */
+  explicit IoUringBackend(unsigned entries = 64);
+
+  ~IoUringBackend() override;
+
+  IoUringBackend(const IoUringBackend &) = delete;
+
+  IoUringBackend &operator=(const IoUringBackend &) = delete;
+
+  io_backend_t kind() const override { return io_backend_t::IO_URING; }
+
+  void submit(std::span<IoRequest> requests) override;
+};
+
+/**
+ * @brief Creates an I/O backend.
+ * @param kind The preferred kind of backend.
+ * @return The backend; a SyncIoBackend if io_uring was requested but is not available.
+ */
+std::unique_ptr<IoBackend> makeIoBackend(io_backend_t kind);
+} // namespace db
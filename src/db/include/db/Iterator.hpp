@@ -1,5 +1,6 @@
 #pragma once
 
+#include <db/BufferPool.hpp>
 #include <db/Tuple.hpp>
 
 namespace db {
@@ -9,6 +10,7 @@ struct Iterator {
   const DbFile &file;
   size_t page;
   size_t slot;
+  mutable PinnedPage pinned; // the page of the last view, if it came from the BufferPool
 
 public:
   Iterator(const DbFile &file, const size_t &page, size_t slot);
@@ -18,6 +20,16 @@ public:
 
   Tuple operator*() const;
 
+  /**
+   * @brief Returns some fields of the current tuple, see DbFile::getTuple.
+   */
+  Tuple project(const Projection &projection) const;
+
+  /**
+   * @brief Returns a view of the current tuple, see DbFile::getTupleView.
+   */
+  TupleView view() const;
+
   Iterator &operator++();
 
   bool operator==(const Iterator &other) const { return page == other.page && slot == other.slot; }
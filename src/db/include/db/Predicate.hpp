@@ -0,0 +1,96 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <vector>
+
+namespace db {
+/**
+ * @brief The slots a page holds at most: a tuple takes at least INT_SIZE bytes.
+ */
+constexpr size_t MAX_PAGE_SLOTS = DEFAULT_PAGE_SIZE / INT_SIZE;
+
+/**
+ * @brief The comparisons of a Predicate.
+ * @details INT and DOUBLE fields support every comparison but PREFIX. CHAR and VARCHAR fields support EQ, NE and
+ * PREFIX.
+ */
+enum class op_t { EQ, NE, LT, LE, GT, GE, PREFIX };
+
+/**
+ * @brief Where the fields of the slots of a page are, for Predicate::evaluate.
+ * @details Field i of slot s is at data + offset_of(i) * scale + starts[s], or at data + offset_of(i) * scale +
+ * s * field_size(i) when starts is null: the layout of a TupleView, with the tuples of the slots at data + starts[s].
+ */
+struct PageFields {
+  const uint8_t *data;
+  size_t scale;           // 1, or the capacity of a PAX page
+  const uint32_t *starts; // the offset of the tuple of each slot, nullptr if the fields are stored in arrays
+  size_t slots;
+};
+
+/**
+ * @brief A filter on the tuples of a scan: comparisons of fields with constants, combined with AND and OR.
+ * @details evaluate() runs on the serialized bytes of a page, 64 slots at a time: comparisons of INT and DOUBLE fields
+ * use AVX2 (with gathers for row pages) or SSE2 when the build targets them, and a scalar loop otherwise. CHAR and
+ * VARCHAR comparisons are scalar and only read the slots that are still candidates.
+ */
+class Predicate {
+  enum class kind_t { COMPARE, AND, OR };
+
+  kind_t kind;
+  size_t field = 0;
+  op_t op = op_t::EQ;
+  field_t value;
+  std::vector<Predicate> children;
+
+  Predicate(kind_t kind, std::vector<Predicate> children);
+
+public:
+  /**
+   * @brief A comparison of a field with a constant, e.g. Predicate(0, op_t::LT, 10) for field 0 < 10.
+   * @param field The index of the field.
+   * @param op The comparison.
+   * @param value The constant: an int for an INT field, a double for a DOUBLE field, a string otherwise.
+   */
+  Predicate(size_t field, op_t op, field_t value);
+
+  /**
+   * @brief The tuples that satisfy every predicate (all of them if there is none).
+   */
+  static Predicate all(std::vector<Predicate> predicates);
+
+  /**
+   * @brief The tuples that satisfy at least one predicate (none if there is none).
+   */
+  static Predicate any(std::vector<Predicate> predicates);
+
+  friend Predicate operator&&(Predicate a, Predicate b) { return all({std::move(a), std::move(b)}); }
+
+  friend Predicate operator||(Predicate a, Predicate b) { return any({std::move(a), std::move(b)}); }
+
+  /**
+   * @brief Checks that the predicate applies to the tuples of a TupleDesc.
+   * @throws std::out_of_range if a field is out of range.
+   * @throws std::logic_error if a constant does not have the type of its field, or a comparison does not apply to it.
+   */
+  void check(const TupleDesc &td) const;
+
+  /**
+   * @brief Evaluates the predicate on one tuple, without SIMD.
+   * @param t A view of a tuple of a TupleDesc accepted by check().
+   */
+  bool matches(const TupleView &t) const;
+
+  /**
+   * @brief Evaluates the predicate on the slots of a page.
+   * @param td A tuple descriptor accepted by check().
+   * @param fields Where the fields are.
+   * @param from The first word to evaluate.
+   * @param words The candidate slots, 64 per word with slot 64 * w first in the most significant bit, like the header
+   * of a HeapPage. The slots that do not satisfy the predicate are cleared in the words from `from` on.
+   * @note Only the candidate slots need to hold a tuple, but INT and DOUBLE comparisons may read the fields of every
+   * slot: the starts of the other slots must still be within the page.
+   */
+  void evaluate(const TupleDesc &td, const PageFields &fields, size_t from, uint64_t *words) const;
+};
+} // namespace db
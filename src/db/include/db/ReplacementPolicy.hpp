@@ -0,0 +1,190 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace db {
+enum class replacement_t { LRU, CLOCK, LRU_K, TWO_Q, ARC };
+
+/**
+ * @brief Decides which frame of a BufferPool is evicted next.
+ * @details A ReplacementPolicy tracks the frames that hold a page. The BufferPool reports every page that is loaded
+ * into a frame, every hit and every page that leaves a frame, and asks the policy for a victim when it is full.
+ * @note Frames are identified by their position in the BufferPool.
+ */
+class ReplacementPolicy {
+public:
+  virtual ~ReplacementPolicy() = default;
+
+  /**
+   * @brief Starts tracking a frame that was just loaded with a page.
+   * @param pos The position of the frame.
+   * @param pid The page id of the page loaded in the frame.
+   */
+  virtual void insert(size_t pos, const PageId &pid) = 0;
+
+  /**
+   * @brief Records a hit on a tracked frame.
+   * @param pos The position of the frame.
+   */
+  virtual void access(size_t pos) = 0;
+
+  /**
+   * @brief Stops tracking a frame whose page was evicted or discarded.
+   * @param pos The position of the frame.
+   * @note Policies with a history (LRU-K, 2Q, ARC) may remember the page id of the frame.
+   */
+  virtual void remove(size_t pos) = 0;
+
+  /**
+   * @brief Returns the frame that should be evicted next.
+   * @param evictable Returns whether the frame at a position may be evicted (i.e. it is not pinned).
+   * @return The position of the frame.
+   * @throws std::runtime_error if no tracked frame is evictable.
+   * @note The frame is still tracked until BufferPool calls remove(pos).
+   */
+  virtual size_t victim(const std::function<bool(size_t)> &evictable) = 0;
+};
+
+/**
+ * @brief Creates a replacement policy.
+ * @param policy The kind of policy.
+ * @param capacity The number of frames of the BufferPool.
+ * @return The replacement policy.
+ */
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(replacement_t policy, size_t capacity);
+
+/**
+ * @brief Evicts the least recently used frame.
+ * @details The recency list is linked through a flat array indexed by frame position, so no operation allocates.
+ */
+class LruPolicy : public ReplacementPolicy {
+  static constexpr size_t NIL = static_cast<size_t>(-1);
+
+  struct Link {
+    size_t prev = NIL; // more recently used neighbour
+    size_t next = NIL; // less recently used neighbour
+  };
+
+  std::vector<Link> links;
+  size_t head = NIL; // most recently used frame
+  size_t tail = NIL; // least recently used frame
+
+  void link(size_t pos);
+
+  void unlink(size_t pos);
+
+public:
+  explicit LruPolicy(size_t capacity);
+  void insert(size_t pos, const PageId &pid) override;
+  void access(size_t pos) override;
+  void remove(size_t pos) override;
+  size_t victim(const std::function<bool(size_t)> &evictable) override;
+};
+
+/**
+ * @brief Approximates LRU with one reference bit per frame and a sweeping clock hand.
+ */
+class ClockPolicy : public ReplacementPolicy {
+  std::vector<uint8_t> present;
+  std::vector<uint8_t> referenced;
+  size_t hand = 0;
+  size_t count = 0;
+
+public:
+  explicit ClockPolicy(size_t capacity);
+  void insert(size_t pos, const PageId &pid) override;
+  void access(size_t pos) override;
+  void remove(size_t pos) override;
+  size_t victim(const std::function<bool(size_t)> &evictable) override;
+};
+
+/**
+ * @brief Evicts the frame whose K-th most recent access is the oldest (K = 2).
+ * @details Frames that have been accessed fewer than K times are evicted first, in order of their last access, so a
+ * page read once by a scan never displaces a page that was read twice. The access history of evicted pages is
+ * retained for as many pages as there are frames.
+ */
+class LruKPolicy : public ReplacementPolicy {
+  static constexpr size_t K = 2;
+  using history_t = std::array<uint64_t, K>; // most recent first, 0 means no access
+  using key_t = std::pair<uint64_t, size_t>;
+
+  size_t capacity;
+  uint64_t clock = 0;
+  std::vector<PageId> pos_to_pid;
+  std::vector<history_t> history;
+  std::set<key_t> order;
+  std::list<PageId> retained_fifo;
+  std::unordered_map<PageId, std::pair<history_t, std::list<PageId>::iterator>> retained;
+
+  key_t key(size_t pos) const;
+
+public:
+  explicit LruKPolicy(size_t capacity);
+  void insert(size_t pos, const PageId &pid) override;
+  void access(size_t pos) override;
+  void remove(size_t pos) override;
+  size_t victim(const std::function<bool(size_t)> &evictable) override;
+};
+
+/**
+ * @brief The full 2Q algorithm (Johnson and Shasha).
+ * @details New pages enter the A1in FIFO. Pages evicted from A1in are remembered in the A1out ghost queue, and only a
+ * page that is loaded again while in A1out is admitted to the Am LRU queue.
+ */
+class TwoQPolicy : public ReplacementPolicy {
+  enum class queue_t : uint8_t { NONE, A1IN, AM };
+
+  size_t kin;
+  size_t kout;
+  std::vector<PageId> pos_to_pid;
+  std::vector<queue_t> queue;
+  std::vector<std::list<size_t>::iterator> pos_to_it;
+  std::list<size_t> a1in;
+  std::list<size_t> am;
+  std::list<PageId> a1out;
+  std::unordered_map<PageId, std::list<PageId>::iterator> a1out_map;
+
+public:
+  explicit TwoQPolicy(size_t capacity);
+  void insert(size_t pos, const PageId &pid) override;
+  void access(size_t pos) override;
+  void remove(size_t pos) override;
+  size_t victim(const std::function<bool(size_t)> &evictable) override;
+};
+
+/**
+ * @brief Adaptive Replacement Cache (Megiddo and Modha).
+ * @details Resident pages are split between T1 (seen once) and T2 (seen at least twice). The ghost lists B1 and B2
+ * remember pages recently evicted from T1 and T2 and adapt the target size of T1.
+ */
+class ArcPolicy : public ReplacementPolicy {
+  enum class list_t : uint8_t { NONE, T1, T2 };
+
+  size_t capacity;
+  size_t p = 0;
+  std::vector<PageId> pos_to_pid;
+  std::vector<list_t> where;
+  std::vector<std::list<size_t>::iterator> pos_to_it;
+  std::list<size_t> t1;
+  std::list<size_t> t2;
+  std::list<PageId> b1;
+  std::list<PageId> b2;
+  std::unordered_map<PageId, std::list<PageId>::iterator> b1_map;
+  std::unordered_map<PageId, std::list<PageId>::iterator> b2_map;
+
+public:
+  explicit ArcPolicy(size_t capacity);
+  void insert(size_t pos, const PageId &pid) override;
+  void access(size_t pos) override;
+  void remove(size_t pos) override;
+  size_t victim(const std::function<bool(size_t)> &evictable) override;
+};
+} // namespace db
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace db {
+/**
+ * @brief A CHAR field of N bytes in a StaticTupleDesc.
+ * @note The runtime TupleDesc only has CHAR fields of CHAR_SIZE bytes.
+ */
+template <size_t N = CHAR_SIZE> struct Char {
+  static_assert(N == CHAR_SIZE, "CHAR fields are CHAR_SIZE bytes");
+};
+
+/**
+ * @brief How a field of a StaticTupleDesc is stored.
+ * @details value_type is the type of the field in a Tuple, view_type the type returned when the field is read in place.
+ */
+template <class T> struct FieldTraits;
+
+template <> struct FieldTraits<int> {
+  using value_type = int;
+  using view_type = int;
+  static constexpr type_t type = type_t::INT;
+  static constexpr size_t size = INT_SIZE;
+
+  static void write(uint8_t *data, int value) { std::memcpy(data, &value, size); }
+
+  static int read(const uint8_t *data) {
+    int value;
+    std::memcpy(&value, data, size);
+    return value;
+  }
+};
+
+template <> struct FieldTraits<double> {
+  using value_type = double;
+  using view_type = double;
+  static constexpr type_t type = type_t::DOUBLE;
+  static constexpr size_t size = DOUBLE_SIZE;
+
+  static void write(uint8_t *data, double value) { std::memcpy(data, &value, size); }
+
+  static double read(const uint8_t *data) {
+    double value;
+    std::memcpy(&value, data, size);
+    return value;
+  }
+};
+
+template <size_t N> struct FieldTraits<Char<N>> {
+  using value_type = std::string;
+  using view_type = std::string_view;
+  static constexpr type_t type = type_t::CHAR;
+  static constexpr size_t size = N;
+
+  // At most N characters, padded with '\0'
+  static void write(uint8_t *data, std::string_view value) {
+    size_t n = std::min(value.size(), N);
+    std::memcpy(data, value.data(), n);
+    std::memset(data + n, 0, N - n);
+  }
+
+  static std::string_view read(const uint8_t *data) {
+    const char *chars = reinterpret_cast<const char *>(data);
+    return {chars, static_cast<size_t>(std::find(chars, chars + N, '\0') - chars)};
+  }
+};
+
+/**
+ * @brief A schema fixed at compile time, e.g. StaticTupleDesc<int, Char<>, double>.
+ * @details The offsets and the length are constants, and serialize, deserialize and the field accessors are unrolled
+ * over the fields: no loop over the types and no switch on type_t. The tuples are laid out like the ones of the
+ * equivalent runtime TupleDesc (see desc()), so both can read and write the same pages, e.g. the pages of a HeapFile.
+ */
+template <class... Fields> class StaticTupleDesc {
+  static constexpr std::array<size_t, sizeof...(Fields)> computeOffsets() {
+    std::array<size_t, sizeof...(Fields)> result{};
+    std::array<size_t, sizeof...(Fields)> sizes{FieldTraits<Fields>::size...};
+    for (size_t i = 1; i < sizes.size(); i++) {
+      result[i] = result[i - 1] + sizes[i - 1];
+    }
+    return result;
+  }
+
+  template <size_t I> using field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+public:
+  static constexpr size_t size = sizeof...(Fields);
+  static constexpr std::array<type_t, size> types{FieldTraits<Fields>::type...};
+  static constexpr std::array<size_t, size> offsets = computeOffsets();
+  static constexpr size_t length = (FieldTraits<Fields>::size + ... + 0);
+
+  /**
+   * @brief The fields of a tuple, e.g. std::tuple<int, std::string, double>.
+   */
+  using values = std::tuple<typename FieldTraits<Fields>::value_type...>;
+
+  /**
+   * @brief Returns the equivalent runtime TupleDesc.
+   * @param names The names of the fields.
+   * @throws std::logic_error if there is not one unique name per field.
+   */
+  static TupleDesc desc(const std::vector<std::string> &names) {
+    return {std::vector<type_t>(types.begin(), types.end()), names};
+  }
+
+  /**
+   * @brief Returns whether a runtime TupleDesc has the same fields, so that it lays out tuples the same way.
+   */
+  static bool matches(const TupleDesc &td) {
+    if (td.size() != size) {
+      return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (td.field_type(i) != types[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Reads field I in place: an int, a double or a std::string_view of the bytes.
+   */
+  template <size_t I> static typename FieldTraits<field<I>>::view_type get(const uint8_t *data) {
+    return FieldTraits<field<I>>::read(data + offsets[I]);
+  }
+
+  /**
+   * @brief Writes field I in place.
+   */
+  template <size_t I> static void set(uint8_t *data, typename FieldTraits<field<I>>::view_type value) {
+    FieldTraits<field<I>>::write(data + offsets[I], value);
+  }
+
+  static void serialize(uint8_t *data, const values &v) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (set<I>(data, std::get<I>(v)), ...);
+    }(std::index_sequence_for<Fields...>{});
+  }
+
+  /**
+   * @brief Serializes a Tuple, like TupleDesc::serialize.
+   * @throws std::logic_error if the Tuple does not have the fields of the schema.
+   */
+  static void serialize(uint8_t *data, const Tuple &t) {
+    if (t.size() != size) {
+      throw std::logic_error("Tuple is not compatible with this TupleDesc.");
+    }
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      auto fields = std::make_tuple(std::get_if<typename FieldTraits<Fields>::value_type>(&t.get_field(I))...);
+      if (!(std::get<I>(fields) && ...)) {
+        throw std::logic_error("Tuple is not compatible with this TupleDesc.");
+      }
+      (set<I>(data, *std::get<I>(fields)), ...);
+    }(std::index_sequence_for<Fields...>{});
+  }
+
+  static values read(const uint8_t *data) {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return values(typename FieldTraits<Fields>::value_type(get<I>(data))...);
+    }(std::index_sequence_for<Fields...>{});
+  }
+
+  /**
+   * @brief Deserializes a Tuple, like TupleDesc::deserialize.
+   */
+  static Tuple deserialize(const uint8_t *data) {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return Tuple({field_t(typename FieldTraits<Fields>::value_type(get<I>(data)))...});
+    }(std::index_sequence_for<Fields...>{});
+  }
+};
+} // namespace db
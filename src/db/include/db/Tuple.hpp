@@ -1,26 +1,35 @@
 #pragma once
 
 #include <db/types.hpp>
+#include <memory_resource>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace db {
 class TupleDesc;
+class TupleView;
 
 class Tuple {
   std::vector<field_t> fields;
 
 public:
   Tuple(const std::vector<field_t> &fields);
+  Tuple(std::vector<field_t> &&fields) noexcept : fields(std::move(fields)) {}
   type_t field_type(size_t i) const;
   size_t size() const;
   const field_t &get_field(size_t i) const;
+  bool operator==(const Tuple &other) const = default;
 };
 
 class TupleDesc {
   // TODO pa2: add private members
   std::vector<type_t> types;           // Types of fields in the tuple
   std::vector<std::string> names;      // Names of fields in the tuple
+  std::vector<size_t> lengths;         // Maximum number of characters of the VARCHAR fields, 0 for the other fields
+  std::vector<size_t> offsets;         // Offsets of the fields, computed once by the constructor
+  size_t row_length = 0;               // Bytes of the fixed part of a serialized tuple
+  bool variable = false;               // Whether there is a VARCHAR field
 public:
   TupleDesc() = default;
   /**
@@ -30,13 +39,27 @@ public:
    * @param types the types of the fields
    * @throws std::logic_error if types and names have different lengths
    * @throws std::logic_error if names are not unique
+   * @note VARCHAR fields hold up to DEFAULT_VARCHAR_LENGTH characters.
    */
   TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names);
 
+  /**
+   * @brief Construct a new Tuple Desc object with VARCHAR(n) fields
+   * @param types the types of the fields
+   * @param names the names of the fields
+   * @param lengths the maximum number of characters n of each VARCHAR field; the entries of the other fields are
+   * ignored
+   * @throws std::logic_error if types, names and lengths have different lengths
+   * @throws std::logic_error if names are not unique
+   * @throws std::logic_error if a VARCHAR field may not hold any character or does not fit in a page
+   */
+  TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names,
+            const std::vector<size_t> &lengths);
+
   /**
    * @brief Check if the provided Tuple is compatible with this TupleDesc
    * @details A Tuple is compatible with a TupleDesc if the Tuple has the same number of fields and each field is of the
-   * same type as the corresponding field in the TupleDesc
+   * same type as the corresponding field in the TupleDesc. A VARCHAR(n) field takes a string of at most n characters
    * @param tuple the Tuple to check
    * @return true if the Tuple is compatible, false otherwise
    */
@@ -44,9 +67,11 @@ public:
 
   /**
    * @brief Get offset of the field
-   * @details The offset of the field is the number of bytes from the start of the Tuple to the start of the field
+   * @details The offset of the field is the number of bytes from the start of the Tuple to the start of the field.
+   * For a VARCHAR field, it is the offset of the (offset, length) pair that locates its characters
    * @param index the index of the field
    * @return the offset of the field
+   * @note The offsets are computed once, when the TupleDesc is constructed.
    */
   size_t offset_of(const size_t &index) const;
 
@@ -64,18 +89,69 @@ public:
    */
   size_t size() const;
 
+  /**
+   * @brief Get the type of a field
+   * @param index the index of the field
+   * @return the type of the field
+   * @throws std::out_of_range if the index is out of range
+   */
+  type_t field_type(size_t index) const;
+
+  /**
+   * @brief Get the size of a field
+   * @param index the index of the field
+   * @return the number of bytes of the field in the fixed part of a serialized Tuple
+   * @throws std::out_of_range if the index is out of range
+   */
+  size_t field_size(size_t index) const;
+
+  /**
+   * @brief Get the maximum number of characters of a field
+   * @param index the index of the field
+   * @return n for a VARCHAR(n) field, CHAR_SIZE for a CHAR field, 0 for the other fields
+   * @throws std::out_of_range if the index is out of range
+   */
+  size_t max_chars(size_t index) const;
+
+  /**
+   * @brief Check if the tuples have a fixed length
+   * @return false if there is a VARCHAR field, true otherwise
+   */
+  bool fixed_length() const { return !variable; }
+
   /**
    * @brief Get the length of the TupleDesc
-   * @return the number of bytes needed to serialize a Tuple with this TupleDesc
+   * @return the number of bytes needed to serialize a Tuple with this TupleDesc. With VARCHAR fields, the length of the
+   * fixed part: the characters follow it.
    */
   size_t length() const;
 
+  /**
+   * @brief Get the length of a serialized Tuple
+   * @param t a Tuple compatible with this TupleDesc
+   * @return the number of bytes serialize writes for t
+   */
+  size_t length(const Tuple &t) const;
+
   /**
    * @brief Serialize a Tuple
-   * @param data the buffer to serialize the Tuple into
+   * @details The fields are written at their offsets. The characters of the VARCHAR fields are appended after the
+   * fixed part, in the order of the fields.
+   * @param data the buffer to serialize the Tuple into, of at least length(t) bytes
    * @param t the Tuple to serialize
+   * @return the number of bytes written
+   * @throws std::logic_error if the Tuple is not compatible with this TupleDesc
    */
-  void serialize(uint8_t *data, const Tuple &t) const;
+  size_t serialize(uint8_t *data, const Tuple &t) const;
+
+  /**
+   * @brief Serialize a Tuple that is known to be compatible, as serialize does
+   * @details For batches whose tuples were checked with compatible() beforehand, so that they are not checked twice.
+   * @param data the buffer to serialize the Tuple into, of at least length(t) bytes
+   * @param t a Tuple compatible with this TupleDesc
+   * @return the number of bytes written
+   */
+  size_t serialize_unchecked(uint8_t *data, const Tuple &t) const;
 
   /**
    * @brief Deserialize a Tuple
@@ -84,6 +160,15 @@ public:
    */
   Tuple deserialize(const uint8_t *data) const;
 
+  /**
+   * @brief Project a TupleDesc
+   * @param fields the indices of the fields to keep, in the order of the result
+   * @return the TupleDesc of the fields, with their names and VARCHAR lengths
+   * @throws std::out_of_range if an index is out of range
+   * @throws std::logic_error if a field is listed twice
+   */
+  TupleDesc project(const std::vector<size_t> &fields) const;
+
   /**
    * @brief Merge two TupleDescs
    * @details The merged TupleDesc has all the fields of the two TupleDescs
@@ -93,4 +178,236 @@ public:
    */
   static db::TupleDesc merge(const TupleDesc &td1, const TupleDesc &td2);
 };
+
+/**
+ * @brief Some fields of a TupleDesc, in a given order.
+ * @details The offsets and types of the fields are looked up once, when the projection is built: deserializing a
+ * tuple through the projection only decodes its fields, into a Tuple of the projected TupleDesc.
+ * @note The projection does not own the source TupleDesc: it must not outlive it.
+ */
+class Projection {
+  const TupleDesc *source;
+  std::vector<size_t> fields;
+  std::vector<size_t> offsets; // the offsets of the fields in the source
+  TupleDesc td;
+
+public:
+  /**
+   * @brief Construct a projection from the indices of the fields
+   * @param source the TupleDesc of the tuples
+   * @param fields the indices of the fields to keep, in the order of the result
+   * @throws std::out_of_range if an index is out of range
+   * @throws std::logic_error if a field is listed twice
+   */
+  Projection(const TupleDesc &source, const std::vector<size_t> &fields);
+
+  /**
+   * @brief Construct a projection from the names of the fields
+   * @param source the TupleDesc of the tuples
+   * @param names the names of the fields to keep, in the order of the result
+   * @throws std::logic_error if a name is not found or is listed twice
+   */
+  Projection(const TupleDesc &source, const std::vector<std::string> &names);
+
+  const TupleDesc &getSource() const { return *source; }
+
+  /**
+   * @brief Get the TupleDesc of the projected tuples
+   */
+  const TupleDesc &getTupleDesc() const { return td; }
+
+  /**
+   * @brief Get the index in the source of each projected field
+   */
+  const std::vector<size_t> &getFields() const { return fields; }
+
+  /**
+   * @brief Deserialize the projected fields of a Tuple
+   * @param data the buffer of a Tuple serialized with the source TupleDesc
+   */
+  Tuple deserialize(const uint8_t *data) const;
+
+  /**
+   * @brief Copy the projected fields of a view into a Tuple
+   * @param view a view of a Tuple of the source TupleDesc
+   */
+  Tuple materialize(const TupleView &view) const;
+};
+
+/**
+ * @brief A read-only view of a serialized Tuple.
+ * @details A TupleView reads the fields straight from the serialized bytes (e.g. a slot of a page) when they are
+ * requested: nothing is copied or allocated, and CHAR fields are returned as a std::string_view of the bytes before the
+ * first '\0'.
+ * @note The view does not own the bytes nor the TupleDesc: it must not outlive them.
+ */
+class TupleView {
+  const TupleDesc *td = nullptr;
+  const uint8_t *data = nullptr;
+  // Field i is at data + offset_of(i) * capacity + field_size(i) * slot: a row has a capacity of 1 and a slot of 0
+  size_t capacity = 1;
+  size_t slot = 0;
+
+  const uint8_t *field(size_t i, type_t type) const;
+
+public:
+  TupleView() = default;
+
+  /**
+   * @brief Construct a view of a serialized Tuple
+   * @param td the TupleDesc the Tuple was serialized with
+   * @param data the serialized Tuple
+   */
+  TupleView(const TupleDesc &td, const uint8_t *data) : td(&td), data(data) {}
+
+  /**
+   * @brief Construct a view of a Tuple stored column by column, e.g. in a PAX page
+   * @details Each field is stored in an array of capacity values, which follows the array of the previous field.
+   * @param td the TupleDesc the Tuple was serialized with, without VARCHAR fields
+   * @param data the array of the first field
+   * @param capacity the number of values of each array
+   * @param slot the index of the Tuple in the arrays
+   */
+  TupleView(const TupleDesc &td, const uint8_t *data, size_t capacity, size_t slot)
+      : td(&td), data(data), capacity(capacity), slot(slot) {}
+
+  /**
+   * @brief Get the number of fields of the Tuple
+   */
+  size_t size() const { return td->size(); }
+
+  type_t field_type(size_t i) const { return td->field_type(i); }
+
+  const TupleDesc &getTupleDesc() const { return *td; }
+
+  /**
+   * @brief Get an INT field
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not an INT
+   */
+  int get_int(size_t i) const;
+
+  /**
+   * @brief Get a DOUBLE field
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not a DOUBLE
+   */
+  double get_double(size_t i) const;
+
+  /**
+   * @brief Get a CHAR or VARCHAR field
+   * @return the characters of the field, which point into the serialized bytes
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not a CHAR or a VARCHAR
+   */
+  std::string_view get_char(size_t i) const;
+
+  /**
+   * @brief Get the number of bytes of the Tuple serialized by TupleDesc::serialize
+   */
+  size_t length() const;
+
+  /**
+   * @brief Serialize the Tuple, as TupleDesc::serialize would
+   * @param out the buffer to serialize the Tuple into, of at least length() bytes
+   */
+  void serialize(uint8_t *out) const;
+
+  /**
+   * @brief Copy the fields into a Tuple
+   * @return the Tuple that TupleDesc::deserialize would return
+   */
+  Tuple materialize() const;
+};
+
+/**
+ * @brief A Tuple stored in a single buffer, in the format of TupleDesc::serialize.
+ * @details The fields are not variants: numbers are stored in place and CHAR fields in CHAR_SIZE bytes inline, the
+ * characters of the VARCHAR fields after the fixed part. Building a FlatTuple allocates its buffer only, from its
+ * allocator: e.g. a std::pmr::vector<FlatTuple> backed by a std::pmr::monotonic_buffer_resource materializes any number
+ * of tuples with a constant number of allocations.
+ * @note The FlatTuple does not own the TupleDesc: it must not outlive it.
+ */
+class FlatTuple {
+  const TupleDesc *td;
+  std::pmr::vector<uint8_t> data;
+
+public:
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
+  /**
+   * @brief Serialize a Tuple
+   * @param td the TupleDesc of the Tuple
+   * @param t the Tuple
+   * @param alloc the allocator of the buffer
+   * @throws std::logic_error if the Tuple is not compatible with the TupleDesc
+   */
+  FlatTuple(const TupleDesc &td, const Tuple &t, allocator_type alloc = {});
+
+  /**
+   * @brief Copy the Tuple of a view, e.g. a tuple of a page
+   * @param view the view
+   * @param alloc the allocator of the buffer
+   */
+  explicit FlatTuple(const TupleView &view, allocator_type alloc = {});
+
+  FlatTuple(const FlatTuple &other, allocator_type alloc = {}) : td(other.td), data(other.data, alloc) {}
+  FlatTuple(FlatTuple &&other) noexcept = default;
+  FlatTuple(FlatTuple &&other, allocator_type alloc) : td(other.td), data(std::move(other.data), alloc) {}
+  FlatTuple &operator=(const FlatTuple &other) = default;
+  FlatTuple &operator=(FlatTuple &&other) = default;
+
+  allocator_type get_allocator() const { return data.get_allocator(); }
+
+  const TupleDesc &getTupleDesc() const { return *td; }
+
+  /**
+   * @brief Get the serialized bytes
+   */
+  const uint8_t *bytes() const { return data.data(); }
+
+  /**
+   * @brief Get a view of the fields, see TupleView
+   * @note The view is invalidated when the FlatTuple is modified, moved or destroyed.
+   */
+  TupleView view() const { return {*td, data.data()}; }
+
+  size_t size() const;
+
+  type_t field_type(size_t i) const;
+
+  int get_int(size_t i) const { return view().get_int(i); }
+
+  double get_double(size_t i) const { return view().get_double(i); }
+
+  std::string_view get_char(size_t i) const { return view().get_char(i); }
+
+  /**
+   * @brief Set an INT field
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not an INT
+   */
+  void set_int(size_t i, int value);
+
+  /**
+   * @brief Set a DOUBLE field
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not a DOUBLE
+   */
+  void set_double(size_t i, double value);
+
+  /**
+   * @brief Set a CHAR or VARCHAR field
+   * @details A CHAR field keeps at most CHAR_SIZE characters, like TupleDesc::serialize. The characters of the VARCHAR
+   * fields after a VARCHAR field move when its length changes.
+   * @throws std::out_of_range if the index is out of range
+   * @throws std::logic_error if the field is not a CHAR or a VARCHAR, or the value is longer than a VARCHAR field
+   */
+  void set_char(size_t i, std::string_view value);
+
+  /**
+   * @brief Copy the fields into a Tuple
+   */
+  Tuple materialize() const { return view().materialize(); }
+};
 } // namespace db
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <variant>
 
@@ -9,26 +12,52 @@ namespace db {
 constexpr size_t INT_SIZE = sizeof(int);
 constexpr size_t DOUBLE_SIZE = sizeof(double);
 constexpr size_t CHAR_SIZE = 64;
+constexpr size_t VARCHAR_SIZE = 2 * sizeof(uint16_t); // the (offset, length) of the characters, in the fixed part
+constexpr size_t DEFAULT_VARCHAR_LENGTH = 255;
 
-enum class type_t { INT, CHAR, DOUBLE };
+enum class type_t { INT, CHAR, DOUBLE, VARCHAR };
 
 using field_t = std::variant<int, double, std::string>;
 
+/**
+ * @brief Compact identifier of a DbFile, assigned by Database::add.
+ */
+using file_id_t = uint32_t;
+
+constexpr file_id_t INVALID_FILE_ID = std::numeric_limits<file_id_t>::max();
+
+/**
+ * @brief Identifies a page as a (file id, page number) pair packed in 64 bits.
+ * @note PageId is trivially copyable: building, hashing and comparing one never allocates.
+ */
 struct PageId {
-  std::string file;
-  size_t page;
+  file_id_t file = INVALID_FILE_ID;
+  uint32_t page = 0;
 
 public:
+  constexpr PageId() = default;
+  constexpr PageId(file_id_t file, size_t page) : file(file), page(static_cast<uint32_t>(page)) {}
+
+  constexpr uint64_t key() const { return static_cast<uint64_t>(file) << 32 | page; }
+
   bool operator==(const PageId &) const = default;
 };
 
+static_assert(sizeof(PageId) == sizeof(uint64_t));
+static_assert(std::is_trivially_copyable_v<PageId>);
+
 constexpr size_t DEFAULT_PAGE_SIZE = 4096;
 
 using Page = std::array<uint8_t, DEFAULT_PAGE_SIZE>;
 } // namespace db
 
-template <> struct std::hash<const db::PageId> {
+// The splitmix64 finalizer: every bit of the file id and page number affects every bit of the hash,
+// so consecutive pages spread over the buckets and shards.
+template <> struct std::hash<db::PageId> {
   std::size_t operator()(const db::PageId &r) const {
-    return std::hash<std::string>()(r.file) ^ std::hash<size_t>()(r.page);
+    uint64_t x = r.key();
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
   }
 };
@@ -0,0 +1,686 @@
+#include <db/Database.hpp>
+#include <db/FrameTable.hpp>
+#include <db/HeapFile.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+TEST(BufferPoolTest, Capacity) {
+  EXPECT_EQ(db::BufferPoolOptions{}.num_pages, db::DEFAULT_NUM_PAGES);
+  EXPECT_EQ(db::BufferPoolOptions::fromBytes(1 << 20).num_pages, 256);
+  EXPECT_ANY_THROW(db::BufferPool({0}));
+
+  db::Database &db = db::initDatabase({{1000}});
+  EXPECT_EQ(&db, &db::getDatabase());
+  EXPECT_EQ(db.getBufferPool().capacity(), 1000);
+  EXPECT_ANY_THROW(db::initDatabase({}));
+}
+
+TEST(BufferPoolTest, FileIds) {
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  std::remove("ids1");
+  std::remove("ids2");
+  auto file = std::make_unique<db::HeapFile>("ids1", db::TupleDesc(types, names));
+  EXPECT_EQ(file->getId(), db::INVALID_FILE_ID);
+  db.add(std::move(file));
+  db.add(std::make_unique<db::HeapFile>("ids2", db::TupleDesc(types, names)));
+  db::file_id_t id1 = db.get("ids1").getId();
+  db::file_id_t id2 = db.get("ids2").getId();
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(&db.get(id2), &db.get("ids2"));
+
+  // ids are not reused after a file is removed
+  db.remove("ids1");
+  EXPECT_THROW(db.get(id1), std::out_of_range);
+  db.add(std::make_unique<db::HeapFile>("ids1", db::TupleDesc(types, names)));
+  EXPECT_NE(db.get("ids1").getId(), id1);
+
+  EXPECT_NE(std::hash<db::PageId>()({id1, 0}), std::hash<db::PageId>()({id1, 1}));
+  EXPECT_EQ(db::PageId(id2, 3), db::PageId(id2, 3));
+}
+
+
+TEST(BufferPoolTest, RemoveLatchedFile) {
+  // A file is only removed once its pages have been written, and none of its frames outlives it
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "removelatched";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  file.insertTuple({{1, "Hello", 3.14}});
+  db::PageId pid{file.getId(), 0};
+
+  // Another thread writes the page until it is told to release it
+  std::atomic<bool> latched = false;
+  std::atomic<bool> done = false;
+  std::thread writer([&] {
+    db::WritePageGuard guard = bufferPool.fetchWrite(pid);
+    latched = true;
+    while (!done) {
+      std::this_thread::yield();
+    }
+  });
+  while (!latched) {
+    std::this_thread::yield();
+  }
+  bufferPool.markDirty(pid);
+  EXPECT_FALSE(bufferPool.flushPage(pid));
+  EXPECT_FALSE(bufferPool.flushFile(name));
+  EXPECT_THROW(db.remove(name), std::logic_error);
+  EXPECT_EQ(&db.get(pid.file), &file);
+  done = true;
+  writer.join();
+
+  EXPECT_TRUE(bufferPool.isDirty(pid));
+  EXPECT_TRUE(bufferPool.flushPage(pid));
+  bufferPool.markDirty(pid);
+  auto removed = db.remove(name);
+  EXPECT_FALSE(bufferPool.contains(pid));
+  EXPECT_THROW(db.get(pid.file), std::out_of_range);
+}
+
+TEST(BufferPoolTest, FrameAlignment) {
+  db::Database &db = db::initDatabase({{8}});
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "arenafile";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  db::Page &page = db.getBufferPool().getPage({db.get(name).getId(), 0});
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(page.data()) % db::DEFAULT_PAGE_SIZE, 0);
+}
+
+TEST(BufferPoolTest, HugePageArena) {
+  db::FrameArena arena(1000, true);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&arena[0]) % db::HUGE_PAGE_SIZE, 0);
+  for (size_t i = 0; i < arena.size(); i++) {
+    arena[i].fill(static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(arena[999][0], static_cast<uint8_t>(999));
+}
+
+TEST(BufferPoolTest, SmallPool) {
+  // A file larger than the pool must survive evicting its dirty pages
+  db::Database &db = db::initDatabase({{2}});
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "smallpool";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 5;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  EXPECT_EQ(file.getNumPages(), 5);
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+}
+
+static bool all(size_t) { return true; }
+
+TEST(FrameTableTest, InsertFindErase) {
+  db::FrameTable table(64);
+  std::unordered_map<db::PageId, size_t> expected;
+  // Interleave inserts and erases so that entries are shifted back across wrapped probe sequences
+  for (size_t round = 0; round < 20; round++) {
+    for (size_t i = 0; expected.size() < 64; i++) {
+      db::PageId pid{static_cast<db::file_id_t>(round % 3), round * 64 + i};
+      table.insert(pid, i);
+      expected[pid] = i;
+    }
+    EXPECT_ANY_THROW(table.insert({7, 0}, 0));
+    for (auto it = expected.begin(); it != expected.end();) {
+      if (it->first.page % 3 == round % 3) {
+        table.erase(it->first);
+        EXPECT_FALSE(table.contains(it->first));
+        it = expected.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    EXPECT_EQ(table.size(), expected.size());
+    for (const auto &[pid, pos] : expected) {
+      EXPECT_EQ(table.find(pid), pos);
+    }
+  }
+  EXPECT_EQ(table.find({}), db::FrameTable::npos);
+}
+
+TEST(ReplacementPolicyTest, LRU) {
+  db::LruPolicy policy(3);
+  for (size_t i = 0; i < 3; i++) {
+    policy.insert(i, {0, i});
+  }
+  EXPECT_EQ(policy.victim(all), 0);
+  policy.access(0);
+  EXPECT_EQ(policy.victim(all), 1);
+  policy.remove(1);
+  EXPECT_EQ(policy.victim(all), 2);
+}
+
+TEST(ReplacementPolicyTest, CLOCK) {
+  db::ClockPolicy policy(3);
+  for (size_t i = 0; i < 3; i++) {
+    policy.insert(i, {0, i});
+  }
+  policy.access(0);
+  EXPECT_EQ(policy.victim(all), 1);
+  policy.remove(1);
+  policy.access(2);
+  EXPECT_EQ(policy.victim(all), 0);
+}
+
+TEST(ReplacementPolicyTest, LRUK) {
+  db::LruKPolicy policy(3);
+  for (size_t i = 0; i < 3; i++) {
+    policy.insert(i, {0, i});
+  }
+  policy.access(0);
+  policy.access(1);
+  // only slot 2 has been accessed once
+  EXPECT_EQ(policy.victim(all), 2);
+  policy.remove(2);
+  EXPECT_EQ(policy.victim(all), 0);
+
+  // a page that comes back keeps its history
+  policy.insert(2, {0, 2});
+  EXPECT_EQ(policy.victim(all), 0);
+}
+
+TEST(ReplacementPolicyTest, TwoQ) {
+  db::TwoQPolicy policy(4);
+  for (size_t i = 0; i < 4; i++) {
+    policy.insert(i, {0, i});
+  }
+  EXPECT_EQ(policy.victim(all), 0);
+  policy.remove(0);
+  // page 0 is in A1out: loading it again admits it to Am
+  policy.insert(0, {0, 0});
+  EXPECT_EQ(policy.victim(all), 1);
+  policy.remove(1);
+  policy.remove(2);
+  policy.remove(3);
+  EXPECT_EQ(policy.victim(all), 0);
+}
+
+TEST(ReplacementPolicyTest, ARC) {
+  db::ArcPolicy policy(3);
+  for (size_t i = 0; i < 3; i++) {
+    policy.insert(i, {0, i});
+  }
+  policy.access(0);
+  EXPECT_EQ(policy.victim(all), 1);
+  policy.remove(1);
+  // a ghost hit in B1 goes straight to T2 and makes room for one more page in T1
+  policy.insert(1, {0, 1});
+  EXPECT_EQ(policy.victim(all), 0);
+  policy.remove(0);
+  EXPECT_EQ(policy.victim(all), 1);
+}
+
+static void scanResistance(db::replacement_t policy, size_t ring_size, bool expected) {
+  db::Database &db = db::initDatabase({{8, policy, ring_size}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  // Each test runs in its own process, possibly in parallel: the files of each policy and ring size are distinct
+  std::string suffix = "_" + std::to_string(static_cast<int>(policy)) + "_" + std::to_string(ring_size);
+  std::string hot = "hot" + suffix;
+  std::string scanned = "scanned" + suffix;
+  std::remove(hot.c_str());
+  std::remove(scanned.c_str());
+  db.add(std::make_unique<db::HeapFile>(hot, db::TupleDesc(types, names)));
+  db.add(std::make_unique<db::HeapFile>(scanned, db::TupleDesc(types, names)));
+  auto &file = db.get(scanned);
+  for (int i = 0; i < 53 * 20; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.getPage({db.get(hot).getId(), 0});
+  bufferPool.getPage({db.get(hot).getId(), 0});
+  size_t count = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, 53 * 20);
+  EXPECT_EQ(bufferPool.contains({db.get(hot).getId(), 0}), expected);
+}
+
+TEST(ReplacementPolicyTest, ScanRingLRU) { scanResistance(db::replacement_t::LRU, 2, true); }
+
+TEST(ReplacementPolicyTest, ScanWithoutRingLRU) { scanResistance(db::replacement_t::LRU, 0, false); }
+
+TEST(ReplacementPolicyTest, ScanWithoutRingLRUK) { scanResistance(db::replacement_t::LRU_K, 0, true); }
+
+TEST(ReplacementPolicyTest, ScanRingTwoQ) { scanResistance(db::replacement_t::TWO_Q, 2, true); }
+
+TEST(ReplacementPolicyTest, ScanRingARC) { scanResistance(db::replacement_t::ARC, 2, true); }
+
+TEST(ReplacementPolicyTest, ScanRingCLOCK) { scanResistance(db::replacement_t::CLOCK, 2, true); }
+
+TEST(BufferPoolTest, Shards) {
+  EXPECT_ANY_THROW(db::BufferPool({4, db::replacement_t::LRU, 0, 5}));
+  // By default, every shard has at least MIN_SHARD_PAGES frames
+  EXPECT_EQ(db::BufferPool({4, db::replacement_t::LRU, 0, 0}).getNumShards(), 1);
+  EXPECT_LE(db::BufferPool({100}).getNumShards(), 100 / db::MIN_SHARD_PAGES);
+  db::BufferPool bufferPool({10, db::replacement_t::LRU, 0, 3});
+  EXPECT_EQ(bufferPool.capacity(), 10);
+}
+
+TEST(BufferPoolTest, ConcurrentScans) {
+  constexpr size_t threads = 4;
+  constexpr int size = 53 * 40;
+  // Every shard has room for the pages that all the threads may pin at once: the page each one reads and the frames of
+  // the run of pages it is faulting in
+  db::Database &db = db::initDatabase({{64, db::replacement_t::LRU, 8, 4}});
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  for (size_t t = 0; t < threads; t++) {
+    std::string name = "concurrent" + std::to_string(t);
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+    auto &file = db.get(name);
+    for (int i = 0; i < size; ++i) {
+      file.insertTuple({{i, "Hello", 3.14}});
+    }
+  }
+
+  std::vector<int> sums(threads);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      const auto &file = db.get("concurrent" + std::to_string(t));
+      for (int round = 0; round < 5; round++) {
+        for (auto it = file.begin(); it != file.end(); ++it) {
+          sums[t] += std::get<int>((*it).get_field(0));
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (size_t t = 0; t < threads; t++) {
+    EXPECT_EQ(sums[t], 5 * size * (size - 1) / 2);
+  }
+}
+
+TEST(BufferPoolTest, ConcurrentDirtyPages) {
+  // Every shard has a frame per thread, so that a request always finds a frame that the other threads do not pin
+  db::Database &db = db::initDatabase({{8, db::replacement_t::CLOCK, 0, 2}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "concurrentdirty";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 16; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < 4; t++) {
+    workers.emplace_back([&, t] {
+      for (size_t i = 0; i < 200; i++) {
+        db::PageId pid{file.getId(), (i + t) % 16};
+        bufferPool.getPage(pid);
+        try {
+          bufferPool.markDirty(pid);
+          bufferPool.flushPage(pid);
+        } catch (const std::out_of_range &) {
+          // the page was evicted by another thread in between
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  bufferPool.flushFile(name);
+  size_t count = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, 53 * 16);
+}
+
+TEST(BufferPoolTest, ConcurrentMisses) {
+  // Threads miss on the same pages of several shards: one of them reads each page while the others wait on its frame,
+  // and dirty victims are written while other pages of their shard are read
+  constexpr size_t threads = 4;
+  constexpr size_t pages = 24;
+  db::Database &db = db::initDatabase({{12, db::replacement_t::LRU, 0, 3}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  EXPECT_EQ(bufferPool.getNumShards(), 3);
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "concurrentmisses";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * static_cast<int>(pages); ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  ASSERT_EQ(file.getNumPages(), pages);
+  bufferPool.flushFile(name);
+  bufferPool.discardFile(file.getId());
+
+  // Every thread stamps the last byte of the pages it owns and checks that the other bytes are read back unchanged
+  std::vector<db::Page> expected(pages);
+  for (size_t i = 0; i < pages; i++) {
+    file.readPage(expected[i], i);
+  }
+  std::vector<std::thread> workers;
+  std::atomic<size_t> mismatches = 0;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      for (size_t round = 0; round < 20; round++) {
+        for (size_t i = 0; i < pages; i++) {
+          db::PageId pid{file.getId(), (i * 7 + round) % pages};
+          if (pid.page % threads == t) {
+            auto guard = bufferPool.fetchWrite(pid);
+            (*guard)[db::DEFAULT_PAGE_SIZE - 1] = static_cast<uint8_t>(round);
+          } else {
+            auto guard = bufferPool.fetchRead(pid);
+            if (!std::equal(guard->begin(), guard->end() - 1, expected[pid.page].begin())) {
+              mismatches++;
+            }
+          }
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+  EXPECT_TRUE(bufferPool.flushFile(name));
+  for (size_t i = 0; i < pages; i++) {
+    db::Page page;
+    file.readPage(page, i);
+    EXPECT_EQ(page[db::DEFAULT_PAGE_SIZE - 1], 19);
+  }
+}
+
+TEST(BufferPoolTest, FailedLoads) {
+  // A page that cannot be read is not left in the pool and does not keep its frame
+  db::Database &db = db::initDatabase({{2}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "failedloads";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 2; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  db::PageId missing{file.getId(), file.getNumPages() + 5};
+  for (size_t i = 0; i < 5; i++) {
+    EXPECT_THROW(bufferPool.getPage(missing), std::out_of_range);
+    EXPECT_FALSE(bufferPool.contains(missing));
+  }
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, 53 * 2);
+}
+
+TEST(BufferPoolTest, PageGuards) {
+  db::Database &db = db::initDatabase({{2}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "guards";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 4; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.flushFile(name);
+
+  db::PageId pid{file.getId(), 0};
+  {
+    db::ReadPageGuard guard1 = bufferPool.fetchRead(pid);
+    db::ReadPageGuard guard2 = bufferPool.fetchRead(pid);
+    EXPECT_EQ(&*guard1, &*guard2);
+    EXPECT_TRUE(bufferPool.isPinned(pid));
+    EXPECT_ANY_THROW(bufferPool.discardPage(pid));
+
+    // the pinned page survives a scan of the whole file through the other frame
+    size_t count = 0;
+    for (auto it = file.begin(); it != file.end(); ++it) {
+      count++;
+    }
+    EXPECT_EQ(count, 53 * 4);
+    EXPECT_TRUE(bufferPool.contains(pid));
+
+    // a moved guard keeps the pin
+    db::ReadPageGuard moved = std::move(guard1);
+    EXPECT_FALSE(guard1);
+    EXPECT_TRUE(moved);
+    guard2.release();
+    EXPECT_TRUE(bufferPool.isPinned(pid));
+  }
+  EXPECT_FALSE(bufferPool.isPinned(pid));
+  EXPECT_FALSE(bufferPool.isDirty(pid));
+
+  // every frame pinned: nothing can be loaded
+  {
+    db::ReadPageGuard guard1 = bufferPool.fetchRead({file.getId(), 0});
+    db::ReadPageGuard guard2 = bufferPool.fetchRead({file.getId(), 1});
+    EXPECT_THROW(bufferPool.fetchRead({file.getId(), 2}), std::runtime_error);
+  }
+
+  {
+    db::WritePageGuard guard = bufferPool.fetchWrite(pid);
+    (*guard)[db::DEFAULT_PAGE_SIZE - 1] = 0x42;
+    EXPECT_FALSE(bufferPool.isDirty(pid));
+    // the page is latched for writing, so flushing skips it
+    bufferPool.flushPage(pid);
+  }
+  EXPECT_TRUE(bufferPool.isDirty(pid));
+  bufferPool.flushPage(pid);
+  EXPECT_FALSE(bufferPool.isDirty(pid));
+}
+
+TEST(BufferPoolTest, ReadAhead) {
+  db::BufferPoolOptions options;
+  options.num_pages = 32;
+  options.readahead = 8;
+  db::Database &db = db::initDatabase({options});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "readahead";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 20;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.flushFile(name);
+  for (size_t i = 0; i < file.getNumPages(); i++) {
+    bufferPool.discardPage({file.getId(), i});
+  }
+
+  // the inserts may have read the pages as well, only the reads of the scan are counted
+  auto inserted = static_cast<std::ptrdiff_t>(file.getReads().size());
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+    // give the prefetcher a chance to run ahead of the scan
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(i, size);
+
+  // every page is read by the scan or by the prefetcher, and once more at most if it was prefetched into a frame that
+  // the scan ring recycled before the page was requested
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (bufferPool.getStats().prefetched == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  db::BufferPoolStats stats = bufferPool.getStats();
+  EXPECT_GT(stats.prefetched, 0);
+  EXPECT_LE(stats.prefetch_hits + stats.prefetch_unused, stats.prefetched);
+  for (size_t page = 0; page < file.getNumPages(); page++) {
+    EXPECT_LE(std::count(file.getReads().begin() + inserted, file.getReads().end(), page), 2);
+  }
+}
+
+TEST(BufferPoolTest, SortedFlush) {
+  db::Database &db = db::initDatabase({{16, db::replacement_t::LRU, 0, 4}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "sortedflush";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 10; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.flushFile(name);
+  size_t flushed = file.getWrites().size();
+
+  for (size_t page : {7, 2, 9, 0, 3, 8, 1}) {
+    bufferPool.fetchWrite({file.getId(), page});
+  }
+  bufferPool.flushFile(name);
+  std::vector<size_t> writes(file.getWrites().begin() + flushed, file.getWrites().end());
+  EXPECT_EQ(writes, std::vector<size_t>({0, 1, 2, 3, 7, 8, 9}));
+}
+
+TEST(BufferPoolTest, BackgroundWriter) {
+  db::BufferPoolOptions options;
+  options.num_pages = 8;
+  options.clean_fraction = 1;
+  db::Database &db = db::initDatabase({options});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "writer";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 4;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+
+  // the writer cleans every frame in the background
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (bufferPool.isDirty({file.getId(), 3}) && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_FALSE(bufferPool.isDirty({file.getId(), 3}));
+  EXPECT_GT(bufferPool.getStats().background_writes, 0);
+
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+}
+
+TEST(BufferPoolTest, ScanRuns) {
+  // Scan misses read runs of pages with one vectored read, reads are still accounted per page. With a single shard,
+  // the runs cover every page in order
+  db::Database &db = db::initDatabase({{32, db::replacement_t::LRU, db::DEFAULT_RING_SIZE, 1}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "scanruns";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 24;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.flushFile(name);
+  for (size_t i = 0; i < file.getNumPages(); i++) {
+    bufferPool.discardPage({file.getId(), i});
+  }
+
+  size_t reads = file.getReads().size();
+  size_t misses = bufferPool.getStats().misses;
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+  std::vector<size_t> scanned(file.getReads().begin() + static_cast<std::ptrdiff_t>(reads), file.getReads().end());
+  std::vector<size_t> expected(file.getNumPages());
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(scanned, expected);
+  EXPECT_LE(bufferPool.getStats().misses - misses, file.getNumPages() / 4);
+
+  // Direct vectored reads return the pages that were written
+  std::vector<db::Page> pages(3);
+  std::vector<db::Page *> frames{&pages[0], &pages[1], &pages[2]};
+  file.readPages(1, 3, frames.data());
+  EXPECT_EQ(pages[2], bufferPool.getPage({file.getId(), 3}, db::access_t::SEQUENTIAL));
+  EXPECT_THROW(file.readPages(file.getNumPages() - 1, 2, frames.data()), std::out_of_range);
+}
+
+TEST(BufferPoolTest, FrameMetadata) {
+  // HeapFile caches the slot counts of its pages with their frames until the frames change pages
+  db::Database &db = db::initDatabase({{4}});
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "metadata";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 + 10; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  file.deleteTuple(file.begin());
+  db::HeapPageLayout layout(file.getTupleDesc());
+  {
+    db::ReadPageGuard guard = bufferPool.fetchRead({file.getId(), 0});
+    ASSERT_NE(guard.getMeta(), 0);
+    db::HeapPage cached(*guard, file.getTupleDesc(), layout, guard.getMeta());
+    db::HeapPage counted(*guard, file.getTupleDesc(), layout);
+    EXPECT_FALSE(cached.full());
+    EXPECT_EQ(cached.meta() & UINT32_MAX, counted.meta() & UINT32_MAX);
+  }
+  file.insertTuple({{-1, "Hello", 3.14}});
+  EXPECT_EQ(std::get<int>(file.getTuple(file.begin()).get_field(0)), -1);
+
+  // Changes through getPage and evictions drop the metadata
+  db::PageId pid{file.getId(), 1};
+  bufferPool.getPage(pid)[0] = 0;
+  bufferPool.markDirty(pid);
+  EXPECT_EQ(bufferPool.fetchRead(pid).getMeta(), 0);
+  int count = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, 53 + 2);
+  EXPECT_NE(bufferPool.fetchRead(pid).getMeta(), 0);
+  bufferPool.flushPage(pid);
+  bufferPool.discardPage(pid);
+  EXPECT_EQ(bufferPool.fetchRead(pid).getMeta(), 0);
+}
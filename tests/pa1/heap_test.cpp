@@ -1,7 +1,10 @@
+#include <db/Chunk.hpp>
 #include <db/Database.hpp>
 #include <db/HeapPage.hpp>
 #include <db/HeapFile.hpp>
+#include <db/Predicate.hpp>
 #include <gtest/gtest.h>
+#include <cstring>
 
 TEST(HeapPageTest, EmptyPage) {
   db::Page page{};
@@ -172,7 +175,7 @@ TEST(HeapFileTest, EmptyPage) {
   std::vector<std::string> names{"id", "name", "price"};
   db::TupleDesc td(types, names);
 
-  const char *name = "heapfile";
+  const char *name = "emptypage";
   std::remove(name);
   db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
   auto &file = db::getDatabase().get(name);
@@ -200,3 +203,655 @@ TEST(HeapFileTest, EmptyPage) {
     i++;
   }
 }
+
+TEST(HeapFileTest, Extents) {
+  // New pages are built in the buffer pool and reach the disk together when they are flushed
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "extents";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED, 4));
+  auto &file = db.get(name);
+  size_t writes = file.getWrites().size();
+  constexpr int size = 53 * 9 + 1;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  EXPECT_EQ(file.getNumPages(), 10);
+  EXPECT_EQ(file.getWrites().size(), writes);
+  EXPECT_EQ(db.getBufferPool().getPage({file.getId(), 9})[0], 0b10000000);
+
+  db.getBufferPool().flushFile(name);
+  std::vector<size_t> flushed(file.getWrites().begin() + static_cast<std::ptrdiff_t>(writes), file.getWrites().end());
+  EXPECT_EQ(flushed, std::vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+  db::HeapFile reopened(name, db::TupleDesc(types, names));
+  EXPECT_EQ(reopened.getNumPages(), 10);
+  db::Page page;
+  reopened.readPage(page, 9);
+  EXPECT_EQ(db::HeapPage(page, reopened.getTupleDesc()).begin(), 0);
+}
+
+TEST(HeapFileTest, FreeSpaceMap) {
+  // Inserts reuse the slots freed by deletes, also after the file is reopened
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "freespace";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 10;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  for (int round = 0; round < 3; round++) {
+    // Free every other tuple, then fill the holes
+    int deleted = 0;
+    for (auto it = file.begin(); it != file.end(); ++it, ++it) {
+      file.deleteTuple(it);
+      deleted++;
+    }
+    for (int i = 0; i < deleted; ++i) {
+      file.insertTuple({{size + i, "Hello", 3.14}});
+    }
+    EXPECT_EQ(file.getNumPages(), 10);
+  }
+
+  // The saved map is used as is: opening the file reads no page
+  file.deleteTuple(file.begin());
+  std::unique_ptr<db::DbFile> removed = db.remove(name);
+  removed.reset();
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &reopened = db.get(name);
+  EXPECT_TRUE(reopened.getReads().empty());
+  reopened.insertTuple({{-1, "Hello", 3.14}});
+  reopened.insertTuple({{-2, "Hello", 3.14}});
+  EXPECT_EQ(reopened.getNumPages(), 11);
+  EXPECT_EQ(std::get<int>(reopened.getTuple(reopened.begin()).get_field(0)), -1);
+
+  // A missing map, e.g. after a crash, is rebuilt from the pages
+  removed = db.remove(name);
+  removed.reset();
+  std::remove("freespace.fsm");
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &rebuilt = db.get(name);
+  EXPECT_EQ(rebuilt.getReads().size(), 11);
+  rebuilt.insertTuple({{-3, "Hello", 3.14}});
+  EXPECT_EQ(rebuilt.getNumPages(), 11);
+}
+
+TEST(HeapPageTest, WordBoundaries) {
+  // Slots are found a word at a time; the result matches a slot by slot scan of the header
+  std::vector<db::TupleDesc> tds{db::TupleDesc({db::type_t::INT}, {"id"}),
+                                  db::TupleDesc({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE},
+                                                {"id", "name", "price"})};
+  for (const db::TupleDesc &td : tds) {
+    for (int pattern = 0; pattern < 6; pattern++) {
+      db::Page page{};
+      db::HeapPage hp(page, td);
+      for (size_t i = 0; i < hp.end(); i++) {
+        bool used = pattern == 0   ? false
+                    : pattern == 1 ? true
+                    : pattern == 2 ? i % 7 == 3
+                    : pattern == 3 ? i >= hp.end() - 5
+                    : pattern == 4 ? i < 300 || i == hp.end() - 1
+                                   : i != 64 && i != hp.end() - 1;
+        if (used) {
+          page[i / 8] |= 1 << (7 - i % 8);
+        }
+      }
+      page[(hp.end() + 7) / 8] = 0xff; // the padding after the header holds no slots
+      db::HeapPage view(page, td);
+      std::vector<size_t> expected;
+      for (size_t i = 0; i < view.end(); i++) {
+        if (!view.empty(i)) {
+          expected.push_back(i);
+        }
+      }
+      std::vector<size_t> found;
+      for (size_t slot = view.begin(); slot != view.end(); view.next(slot)) {
+        found.push_back(slot);
+      }
+      EXPECT_EQ(found, expected);
+
+      // Inserts fill the free slots in order until the page is full
+      std::vector<db::field_t> fields{0, "Hello", 3.14};
+      fields.resize(td.size());
+      size_t free = view.end() - expected.size();
+      for (size_t i = 0; i < free; i++) {
+        EXPECT_FALSE(view.full());
+        EXPECT_TRUE(view.insertTuple(db::Tuple(fields)));
+      }
+      EXPECT_TRUE(view.full());
+      EXPECT_FALSE(view.insertTuple(db::Tuple(fields)));
+      EXPECT_TRUE(db::HeapPage(page, td).full());
+    }
+  }
+}
+
+TEST(HeapFileTest, TupleViews) {
+  // Views read the fields in place; the iterator keeps their page pinned
+  db::Database &db = db::initDatabase({{2}});
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "views";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 4;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  db.getBufferPool().flushFile(name);
+
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    db::TupleView view = it.view();
+    EXPECT_EQ(view.get_int(0), i);
+    EXPECT_EQ(view.get_char(1), "Hello");
+    EXPECT_TRUE(db.getBufferPool().isPinned({file.getId(), it.page}));
+    i++;
+  }
+  EXPECT_EQ(i, size);
+
+  auto it = file.begin();
+  db::TupleView first = it.view();
+  auto copy = it;
+  file.deleteTuple(it);
+  EXPECT_THROW(copy.view(), std::logic_error);
+  EXPECT_EQ(first.get_int(0), 0);
+  EXPECT_FALSE(db.getBufferPool().isPinned({file.getId(), 1}));
+}
+
+TEST(HeapPageTest, Slotted) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR}, {"id", "name"}, {0, 100});
+  db::Page page{};
+  db::HeapPage hp(page, td);
+  EXPECT_EQ(hp.begin(), hp.end());
+
+  // The number of tuples depends on their length: 4 + 4 bytes of fields plus a 4-byte slot each
+  size_t count = 0;
+  while (hp.insertTuple(db::Tuple({static_cast<int>(count), "abcd"}))) {
+    count++;
+  }
+  EXPECT_EQ(count, (db::DEFAULT_PAGE_SIZE - 4) / (4 + 4 + 4 + 4));
+  // The 12 bytes left fit the shortest tuple
+  EXPECT_FALSE(hp.full());
+  EXPECT_TRUE(hp.insertTuple(db::Tuple({-2, ""})));
+  EXPECT_TRUE(hp.full());
+  EXPECT_EQ(hp.end(), ++count);
+
+  // Deleting compacts the page: a longer tuple fits in the space of two short ones
+  hp.deleteTuple(3);
+  EXPECT_FALSE(hp.insertTuple(db::Tuple({-1, std::string(10, 'x')})));
+  hp.deleteTuple(5);
+  EXPECT_TRUE(hp.empty(3));
+  EXPECT_TRUE(hp.insertTuple(db::Tuple({-1, std::string(10, 'x')})));
+  EXPECT_FALSE(hp.empty(3));
+  EXPECT_TRUE(hp.empty(5));
+  EXPECT_EQ(std::get<std::string>(hp.getTuple(3).get_field(1)), std::string(10, 'x'));
+  for (size_t slot = 0; slot < count - 1; slot++) {
+    if (slot != 3 && slot != 5) {
+      EXPECT_EQ(std::get<int>(hp.getTuple(slot).get_field(0)), slot);
+      EXPECT_EQ(std::get<std::string>(hp.getTuple(slot).get_field(1)), "abcd");
+    }
+  }
+
+  // The empty slots at the end of the directory are dropped
+  hp.deleteTuple(count - 1);
+  hp.deleteTuple(count - 2);
+  EXPECT_EQ(hp.end(), count - 2);
+  db::HeapPage reopened(page, td);
+  EXPECT_EQ(reopened.end(), count - 2);
+  size_t slot = reopened.begin();
+  size_t live = 0;
+  for (; slot != reopened.end(); reopened.next(slot)) {
+    live++;
+  }
+  EXPECT_EQ(live, count - 3);
+}
+
+TEST(HeapFileTest, Varchar) {
+  // Short strings take the space they need: the file has far fewer pages than with CHAR fields
+  db::Database &db = db::getDatabase();
+  const char *name = "varchar";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR, db::type_t::DOUBLE}, {"id", "name", "price"}, {0, 64, 0});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 10;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, std::string(i % 8, 'a'), 3.14}});
+  }
+  EXPECT_LE(file.getNumPages(), 4);
+
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    EXPECT_EQ(std::get<int>((*it).get_field(0)), i);
+    EXPECT_EQ(it.view().get_char(1), std::string(i % 8, 'a'));
+    i++;
+  }
+  EXPECT_EQ(i, size);
+
+  // Deleted space is reused and survives a flush
+  size_t pages = file.getNumPages();
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    file.deleteTuple(it);
+  }
+  for (int j = 0; j < size; ++j) {
+    file.insertTuple({{j, std::string(j % 8, 'b'), 2.5}});
+  }
+  EXPECT_EQ(file.getNumPages(), pages);
+  db.getBufferPool().flushFile(name);
+  EXPECT_THROW(file.insertTuple({{0, std::string(65, 'c'), 1.0}}), std::logic_error);
+  EXPECT_THROW(db::HeapFile("varchar_huge", db::TupleDesc({db::type_t::VARCHAR}, {"name"}, {db::DEFAULT_PAGE_SIZE})),
+               std::logic_error);
+}
+
+TEST(HeapPageTest, Pax) {
+  // A PAX page has the slots of a ROW page, with each field stored in its own array
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::HeapPageLayout layout(td, db::page_layout_t::PAX);
+  EXPECT_EQ(layout.capacity, db::HeapPageLayout(td).capacity);
+  db::Page page{};
+  db::HeapPage hp(page, td, layout);
+  for (int i = 0; i < 53; ++i) {
+    EXPECT_TRUE(hp.insertTuple(db::Tuple({i, "name" + std::to_string(i), i * 0.5})));
+  }
+  EXPECT_TRUE(hp.full());
+  EXPECT_FALSE(hp.insertTuple(db::Tuple({-1, "", 0.0})));
+
+  const uint8_t *ids = layout.column(page, td, 0);
+  const uint8_t *prices = layout.column(page, td, 2);
+  for (int i = 0; i < 53; ++i) {
+    int id;
+    double price;
+    std::memcpy(&id, ids + i * sizeof(int), sizeof(int));
+    std::memcpy(&price, prices + i * sizeof(double), sizeof(double));
+    EXPECT_EQ(id, i);
+    EXPECT_EQ(price, i * 0.5);
+    db::TupleView view = layout.view(page, td, i);
+    EXPECT_EQ(view.get_int(0), i);
+    EXPECT_EQ(view.get_char(1), "name" + std::to_string(i));
+    EXPECT_EQ(view.get_double(2), i * 0.5);
+    EXPECT_EQ(std::get<std::string>(hp.getTuple(i).get_field(1)), "name" + std::to_string(i));
+    EXPECT_EQ(std::get<double>(view.materialize().get_field(2)), i * 0.5);
+  }
+
+  hp.deleteTuple(7);
+  EXPECT_THROW(layout.view(page, td, 7), std::logic_error);
+  EXPECT_TRUE(hp.insertTuple(db::Tuple({-7, "seven", 7.0})));
+  EXPECT_EQ(layout.view(page, td, 7).get_int(0), -7);
+  EXPECT_THROW(db::HeapPageLayout(td).column(page, td, 0), std::logic_error);
+  db::TupleDesc variable({db::type_t::INT, db::type_t::VARCHAR}, {"id", "name"});
+  EXPECT_THROW(db::HeapPageLayout(variable, db::page_layout_t::PAX), std::logic_error);
+}
+
+TEST(HeapFileTest, Pax) {
+  // The layout of a file is recorded when it is created and kept when it is reopened
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "pax";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED,
+                                        db::DEFAULT_EXTENT_PAGES, db::page_layout_t::PAX));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 4;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  file.deleteTuple(file.begin());
+  std::unique_ptr<db::DbFile> removed = db.remove(name);
+  removed.reset();
+
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &reopened = dynamic_cast<db::HeapFile &>(db.get(name));
+  EXPECT_EQ(reopened.getPageLayout(), db::page_layout_t::PAX);
+  int i = 1;
+  for (auto it = reopened.begin(); it != reopened.end(); ++it) {
+    EXPECT_EQ(std::get<int>((*it).get_field(0)), i);
+    EXPECT_EQ(it.view().get_char(1), "Hello");
+    i++;
+  }
+  EXPECT_EQ(i, size);
+
+  db::Page page;
+  reopened.readPage(page, 0);
+  const db::HeapPageLayout &layout = reopened.getLayout();
+  int id;
+  std::memcpy(&id, layout.column(page, reopened.getTupleDesc(), 0) + sizeof(int), sizeof(int));
+  EXPECT_EQ(id, 1);
+
+  // Files created without a recorded layout are ROW files
+  removed = db.remove(name);
+  removed.reset();
+  std::remove("pax.layout");
+  EXPECT_EQ(db::HeapFile(name, db::TupleDesc(types, names)).getPageLayout(), db::page_layout_t::ROW);
+}
+
+// Checks that scanning a file in chunks returns the tuples of the iterator, in the same order
+static void expectScan(const db::DbFile &file, size_t capacity) {
+  db::Chunk chunk(file.getTupleDesc(), capacity);
+  auto it = file.begin();
+  auto cursor = file.begin();
+  size_t chunks = 0;
+  while (size_t n = file.scan(cursor, chunk)) {
+    EXPECT_LE(n, capacity);
+    EXPECT_EQ(chunk.selection().size(), n);
+    for (uint32_t row : chunk.selection()) {
+      ASSERT_NE(it, file.end());
+      db::Tuple expected = *it;
+      db::Tuple actual = chunk.materialize(row);
+      for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual.get_field(i), expected.get_field(i));
+      }
+      ++it;
+    }
+    chunks++;
+  }
+  EXPECT_EQ(it, file.end());
+  EXPECT_EQ(cursor, file.end());
+  EXPECT_GT(chunks, 0);
+}
+
+TEST(HeapFileTest, Scan) {
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  for (auto layout : {db::page_layout_t::ROW, db::page_layout_t::PAX}) {
+    std::string name = layout == db::page_layout_t::ROW ? "scan_row" : "scan_pax";
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED,
+                                          db::DEFAULT_EXTENT_PAGES, layout));
+    auto &file = db.get(name);
+    constexpr int size = 53 * 30;
+    for (int i = 0; i < size; ++i) {
+      file.insertTuple({{i, "name" + std::to_string(i), i * 0.25}});
+    }
+    // Holes in the pages, and an empty page
+    int i = 0;
+    for (auto it = file.begin(); it != file.end(); ++it, ++i) {
+      if (i % 3 == 0 || (i >= 53 * 5 && i < 53 * 6)) {
+        file.deleteTuple(it);
+      }
+    }
+    expectScan(file, db::DEFAULT_CHUNK_SIZE);
+    expectScan(file, 100);
+    expectScan(file, 1);
+
+    // The arrays hold the fields of the rows, and filter() narrows the selection
+    db::Chunk chunk(file.getTupleDesc());
+    auto cursor = file.begin();
+    ASSERT_EQ(file.scan(cursor, chunk), db::DEFAULT_CHUNK_SIZE);
+    const int *ids = chunk.ints(0);
+    EXPECT_EQ(ids[0], 1);
+    EXPECT_EQ(ids[1], 2);
+    EXPECT_EQ(chunk.doubles(2)[1], 0.5);
+    EXPECT_EQ(chunk.get_char(1, 1), "name2");
+    chunk.filter([&](uint32_t row) { return ids[row] % 2 == 0; });
+    for (uint32_t row : chunk.selection()) {
+      EXPECT_EQ(ids[row] % 2, 0);
+    }
+    EXPECT_EQ(chunk.selection().size(), db::DEFAULT_CHUNK_SIZE / 2);
+    EXPECT_THROW(chunk.doubles(0), std::logic_error);
+    db::Chunk other(db::TupleDesc({db::type_t::INT}, {"id"}));
+    EXPECT_THROW(file.scan(cursor, other), std::logic_error);
+  }
+
+  // Slotted pages
+  const char *name = "scan_varchar";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR, db::type_t::DOUBLE}, {"id", "name", "price"}, {0, 64, 0});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 10; ++i) {
+    file.insertTuple({{i, std::string(i % 30, 'a'), 1.5}});
+  }
+  file.deleteTuple(file.begin());
+  expectScan(file, 64);
+}
+
+// Checks that a scan with a predicate returns the tuples of the iterator that match it, in the same order
+static void expectFilteredScan(const db::DbFile &file, const db::Predicate &predicate) {
+  db::Chunk chunk(file.getTupleDesc(), 100);
+  auto it = file.begin();
+  auto cursor = file.begin();
+  while (file.scan(cursor, chunk, &predicate)) {
+    for (uint32_t row : chunk.selection()) {
+      while (it != file.end() && !predicate.matches(it.view())) {
+        ++it;
+      }
+      ASSERT_NE(it, file.end());
+      db::Tuple expected = *it;
+      db::Tuple actual = chunk.materialize(row);
+      for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual.get_field(i), expected.get_field(i));
+      }
+      ++it;
+    }
+  }
+  while (it != file.end() && !predicate.matches(it.view())) {
+    ++it;
+  }
+  EXPECT_EQ(it, file.end());
+}
+
+TEST(HeapFileTest, Predicates) {
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  std::vector<db::Predicate> predicates;
+  for (db::op_t op : {db::op_t::EQ, db::op_t::NE, db::op_t::LT, db::op_t::LE, db::op_t::GT, db::op_t::GE}) {
+    predicates.emplace_back(0, op, 700);
+    predicates.emplace_back(2, op, 12.5);
+  }
+  predicates.emplace_back(1, db::op_t::EQ, "name17");
+  predicates.emplace_back(1, db::op_t::NE, "name17");
+  predicates.emplace_back(1, db::op_t::PREFIX, "name1");
+  predicates.push_back(db::Predicate(0, db::op_t::GE, 100) && db::Predicate(2, db::op_t::LT, 50.0));
+  predicates.push_back(db::Predicate(0, db::op_t::LT, 10) || db::Predicate(1, db::op_t::PREFIX, "name99") ||
+                       db::Predicate(2, db::op_t::EQ, 100.0));
+  predicates.push_back(db::Predicate::all({}));
+  predicates.push_back(db::Predicate::any({}));
+
+  for (auto layout : {db::page_layout_t::ROW, db::page_layout_t::PAX}) {
+    std::string name = layout == db::page_layout_t::ROW ? "predicate_row" : "predicate_pax";
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED,
+                                          db::DEFAULT_EXTENT_PAGES, layout));
+    auto &file = db.get(name);
+    for (int i = 0; i < 53 * 30; ++i) {
+      file.insertTuple({{i, "name" + std::to_string(i), (i % 400) * 0.5}});
+    }
+    int i = 0;
+    for (auto it = file.begin(); it != file.end(); ++it, ++i) {
+      if (i % 7 == 0) {
+        file.deleteTuple(it);
+      }
+    }
+    for (const db::Predicate &predicate : predicates) {
+      expectFilteredScan(file, predicate);
+    }
+
+    db::Chunk chunk(file.getTupleDesc());
+    auto cursor = file.begin();
+    db::Predicate one(0, db::op_t::EQ, 701);
+    EXPECT_EQ(file.scan(cursor, chunk, &one), 1);
+    EXPECT_EQ(chunk.ints(0)[0], 701);
+    EXPECT_EQ(file.scan(cursor, chunk, &one), 0);
+    db::Predicate wrongType(0, db::op_t::EQ, 1.0);
+    db::Predicate wrongOp(2, db::op_t::PREFIX, 1.0);
+    db::Predicate wrongField(3, db::op_t::EQ, 1);
+    auto restart = file.begin();
+    EXPECT_THROW(file.scan(restart, chunk, &wrongType), std::logic_error);
+    EXPECT_THROW(file.scan(restart, chunk, &wrongOp), std::logic_error);
+    EXPECT_THROW(file.scan(restart, chunk, &wrongField), std::out_of_range);
+  }
+
+  // Slotted pages
+  const char *name = "predicate_varchar";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR, db::type_t::DOUBLE}, {"id", "name", "price"}, {0, 64, 0});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db.get(name);
+  for (int i = 0; i < 53 * 10; ++i) {
+    file.insertTuple({{i, "name" + std::to_string(i), i * 0.5}});
+  }
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it, ++i) {
+    if (i % 5 == 0) {
+      file.deleteTuple(it);
+    }
+  }
+  for (const db::Predicate &predicate : predicates) {
+    expectFilteredScan(file, predicate);
+  }
+}
+
+TEST(HeapFileTest, Projection) {
+  // Lookups, iteration and scans only decode or copy the projected fields
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  for (auto layout : {db::page_layout_t::ROW, db::page_layout_t::PAX}) {
+    std::string name = layout == db::page_layout_t::ROW ? "projection_row" : "projection_pax";
+    std::remove(name.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::BUFFERED,
+                                          db::DEFAULT_EXTENT_PAGES, layout));
+    auto &file = db.get(name);
+    constexpr int size = 53 * 5;
+    for (int i = 0; i < size; ++i) {
+      file.insertTuple({{i, "name" + std::to_string(i), i * 0.5}});
+    }
+
+    db::Projection projection(file.getTupleDesc(), std::vector<std::string>{"price", "id"});
+    int i = 0;
+    for (auto it = file.begin(); it != file.end(); ++it, ++i) {
+      db::Tuple t = it.project(projection);
+      EXPECT_EQ(t.size(), 2);
+      EXPECT_EQ(std::get<double>(t.get_field(0)), i * 0.5);
+      EXPECT_EQ(std::get<int>(t.get_field(1)), i);
+    }
+    EXPECT_EQ(i, size);
+
+    // The predicate may test fields that are not projected
+    db::Chunk chunk(projection);
+    EXPECT_EQ(chunk.getTupleDesc().size(), 2);
+    db::Predicate predicate(1, db::op_t::PREFIX, "name1");
+    auto cursor = file.begin();
+    size_t matched = 0;
+    while (file.scan(cursor, chunk, &predicate)) {
+      for (uint32_t row : chunk.selection()) {
+        int id = chunk.ints(1)[row];
+        EXPECT_EQ(std::to_string(id)[0], '1');
+        EXPECT_EQ(chunk.doubles(0)[row], id * 0.5);
+        matched++;
+      }
+    }
+    EXPECT_EQ(matched, 1 + 10 + 100);
+
+    db::TupleDesc other({db::type_t::INT}, {"id"});
+    db::Projection wrong(other, std::vector<size_t>{0});
+    EXPECT_THROW(file.getTuple(file.begin(), wrong), std::logic_error);
+    auto it = file.begin();
+    file.deleteTuple(it);
+    EXPECT_THROW(file.getTuple(it, projection), std::logic_error);
+  }
+
+  // Slotted pages
+  const char *name = "projection_varchar";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR, db::type_t::DOUBLE}, {"id", "name", "price"}, {0, 64, 0});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db.get(name);
+  for (int i = 0; i < 100; ++i) {
+    file.insertTuple({{i, std::string(i % 10, 'v'), 1.5}});
+  }
+  db::Projection projection(file.getTupleDesc(), std::vector<size_t>{1});
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it, ++i) {
+    EXPECT_EQ(std::get<std::string>(it.project(projection).get_field(0)), std::string(i % 10, 'v'));
+  }
+  db::Chunk chunk(projection);
+  auto cursor = file.begin();
+  EXPECT_EQ(file.scan(cursor, chunk), 100);
+  EXPECT_EQ(chunk.get_char(0, 13), "vvv");
+}
+
+TEST(HeapFileTest, InsertTuples) {
+  // Batches fill the pages like tuples inserted one at a time, from a vector of Tuples or from serialized bytes
+  db::Database &db = db::getDatabase();
+  db::TupleDesc fixed({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::TupleDesc variable({db::type_t::INT, db::type_t::VARCHAR, db::type_t::DOUBLE}, {"id", "name", "price"},
+                         {0, 64, 0});
+  struct Case {
+    std::string name;
+    const db::TupleDesc &td;
+    db::page_layout_t layout;
+  };
+  for (const Case &c : {Case{"batch_row", fixed, db::page_layout_t::ROW},
+                        Case{"batch_pax", fixed, db::page_layout_t::PAX},
+                        Case{"batch_varchar", variable, db::page_layout_t::ROW}}) {
+    constexpr int size = 53 * 20;
+    std::vector<db::Tuple> tuples;
+    std::vector<uint8_t> rows;
+    for (int i = 0; i < size; ++i) {
+      tuples.push_back({{i, std::string(i % 12, 'a' + i % 26), i * 0.25}});
+      rows.resize(rows.size() + c.td.length(tuples.back()));
+      c.td.serialize(rows.data() + rows.size() - c.td.length(tuples.back()), tuples.back());
+    }
+    std::string one = c.name + "_one";
+    for (const std::string &name : {c.name, c.name + "_rows", one}) {
+      std::remove(name.c_str());
+      db.add(std::make_unique<db::HeapFile>(name, c.td, db::file_mode_t::BUFFERED, db::DEFAULT_EXTENT_PAGES, c.layout));
+    }
+    auto &batch = db.get(c.name);
+    auto &raw = db.get(c.name + "_rows");
+    auto &single = db.get(one);
+    batch.insertTuples(tuples);
+    raw.insertRows(rows);
+    for (const db::Tuple &t : tuples) {
+      single.insertTuple(t);
+    }
+    EXPECT_EQ(batch.getNumPages(), single.getNumPages());
+    EXPECT_EQ(raw.getNumPages(), single.getNumPages());
+    for (const db::DbFile *file : {&batch, &raw}) {
+      int i = 0;
+      for (auto it = file->begin(), expected = single.begin(); it != file->end(); ++it, ++expected, ++i) {
+        EXPECT_EQ(*it, *expected);
+      }
+      EXPECT_EQ(i, size);
+    }
+
+    // The slots freed by deletions are filled first, before new pages
+    size_t pages = batch.getNumPages();
+    int deleted = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      if (std::get<int>((*it).get_field(0)) % 3 == 0) {
+        batch.deleteTuple(it);
+        deleted++;
+      }
+    }
+    batch.insertTuples(std::span(tuples).first(deleted));
+    EXPECT_EQ(batch.getNumPages(), pages);
+    int count = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      count++;
+    }
+    EXPECT_EQ(count, size);
+
+    // A batch is checked before any tuple is inserted
+    std::vector<db::Tuple> wrong{tuples[1], {{1, 2, 3.0}}};
+    EXPECT_THROW(batch.insertTuples(wrong), std::logic_error);
+    EXPECT_THROW(raw.insertRows(std::span(rows).first(rows.size() - 1)), std::logic_error);
+    count = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      count++;
+    }
+    EXPECT_EQ(count, size);
+    EXPECT_EQ(raw.getNumPages(), single.getNumPages());
+  }
+}
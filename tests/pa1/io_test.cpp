@@ -0,0 +1,240 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void roundTrip(db::io_backend_t kind) {
+  std::unique_ptr<db::IoBackend> backend = db::makeIoBackend(kind);
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "iobackend";
+  std::remove(name);
+  db::DbFile file(name, db::TupleDesc(types, names));
+
+  db::Page written;
+  written.fill(42);
+  iovec writeIov{written.data(), db::DEFAULT_PAGE_SIZE};
+  EXPECT_THROW(file.request(true, 1, &writeIov, 1), std::out_of_range);
+  std::vector<db::IoRequest> writes{file.request(true, 0, &writeIov, 1)};
+  backend->submit(writes);
+  EXPECT_NO_THROW(file.complete(writes[0]));
+
+  db::Page read{};
+  iovec readIov{read.data(), db::DEFAULT_PAGE_SIZE};
+  std::vector<db::IoRequest> reads{file.request(false, 0, &readIov, 1)};
+  backend->submit(reads);
+  EXPECT_NO_THROW(file.complete(reads[0]));
+  EXPECT_EQ(read, written);
+  EXPECT_EQ(file.getReads(), std::vector<size_t>({0}));
+  EXPECT_EQ(file.getWrites().back(), 0);
+}
+
+TEST(IoBackendTest, Sync) {
+  EXPECT_EQ(db::makeIoBackend(db::io_backend_t::SYNC)->kind(), db::io_backend_t::SYNC);
+  roundTrip(db::io_backend_t::SYNC);
+}
+
+TEST(IoBackendTest, IoUring) { roundTrip(db::io_backend_t::IO_URING); }
+
+TEST(IoBackendTest, Batch) {
+  // Reads and writes at scattered offsets, some failing, in batches larger than the ring
+  for (db::io_backend_t kind : {db::io_backend_t::SYNC, db::io_backend_t::IO_URING}) {
+    std::unique_ptr<db::IoBackend> backend = db::makeIoBackend(kind);
+    const char *name = "iobatch";
+    std::remove(name);
+    int fd = open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0);
+
+    constexpr size_t count = 200;
+    std::vector<db::Page> pages(count);
+    std::vector<iovec> iov(count);
+    std::vector<db::IoRequest> requests(count);
+    for (size_t i = 0; i < count; i++) {
+      pages[i].fill(static_cast<uint8_t>(i));
+      iov[i] = {pages[i].data(), db::DEFAULT_PAGE_SIZE};
+      requests[i] = {fd, true, i * db::DEFAULT_PAGE_SIZE, &iov[i], 1};
+    }
+    backend->submit(requests);
+    for (const auto &request : requests) {
+      EXPECT_EQ(request.result, db::DEFAULT_PAGE_SIZE);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      pages[i].fill(0);
+      requests[i] = {fd, false, (count - 1 - i) * db::DEFAULT_PAGE_SIZE, &iov[i], 1};
+    }
+    db::IoRequest past{fd, false, count * db::DEFAULT_PAGE_SIZE, &iov[0], 1};
+    requests[0] = past;
+    db::IoRequest closed{-1, false, 0, &iov[1], 1};
+    requests[1] = closed;
+    backend->submit(requests);
+    EXPECT_LT(requests[0].result, 0);
+    EXPECT_LT(requests[1].result, 0);
+    for (size_t i = 2; i < count; i++) {
+      EXPECT_EQ(requests[i].result, db::DEFAULT_PAGE_SIZE);
+      EXPECT_EQ(pages[i][0], static_cast<uint8_t>(count - 1 - i));
+    }
+    close(fd);
+  }
+}
+
+// Submits half of the first requests it is given, then fails as if the kernel were out of memory
+class FailingIoUring : public db::IoUringBackend {
+  int calls = 0;
+
+protected:
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags) override {
+    if (to_submit > 0 && calls++ == 1) {
+      errno = ENOMEM;
+      return -1;
+    }
+    return IoUringBackend::enter(calls == 1 ? to_submit / 2 : to_submit, calls == 1 ? 0 : min_complete, flags);
+  }
+};
+
+TEST(IoBackendTest, IoUringFailure) {
+  // A failed io_uring_enter returns only once the requests in flight are done, and leaves no completion behind
+  std::unique_ptr<FailingIoUring> backend;
+  try {
+    backend = std::make_unique<FailingIoUring>();
+  } catch (const std::runtime_error &) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+  const char *name = "iouringfailure";
+  std::remove(name);
+  int fd = open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  constexpr size_t count = 16;
+  std::vector<db::Page> pages(count);
+  std::vector<iovec> iov(count);
+  std::vector<db::IoRequest> requests(count);
+  for (size_t i = 0; i < count; i++) {
+    pages[i].fill(static_cast<uint8_t>(i));
+    iov[i] = {pages[i].data(), db::DEFAULT_PAGE_SIZE};
+    requests[i] = {fd, true, i * db::DEFAULT_PAGE_SIZE, &iov[i], 1};
+  }
+  backend->submit(requests);
+  for (size_t i = 0; i < count; i++) {
+    EXPECT_EQ(requests[i].result, i < count / 2 ? static_cast<ssize_t>(db::DEFAULT_PAGE_SIZE) : -ENOMEM);
+  }
+
+  // The next batch only reaps its own completions
+  for (size_t i = 0; i < count; i++) {
+    pages[i].fill(0);
+    requests[i] = {fd, false, (i % (count / 2)) * db::DEFAULT_PAGE_SIZE, &iov[i], 1};
+  }
+  backend->submit(requests);
+  for (size_t i = 0; i < count; i++) {
+    EXPECT_EQ(requests[i].result, db::DEFAULT_PAGE_SIZE);
+    EXPECT_EQ(pages[i][0], static_cast<uint8_t>(i % (count / 2)));
+  }
+  close(fd);
+}
+
+TEST(IoBackendTest, BufferPool) {
+  // Prefetching and flushing go through io_uring
+  db::DatabaseOptions options;
+  options.buffer_pool.num_pages = 16;
+  options.buffer_pool.readahead = 8;
+  options.io_backend = db::io_backend_t::IO_URING;
+  db::Database &db = db::initDatabase(options);
+  db::BufferPool &bufferPool = db.getBufferPool();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "iouring";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names)));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 40;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  bufferPool.flushFile(name);
+
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+}
+
+TEST(IoBackendTest, DirectIo) {
+  // O_DIRECT pages bypass the page cache; the pool frames live in huge pages
+  db::DatabaseOptions options;
+  options.buffer_pool.num_pages = 8;
+  options.buffer_pool.readahead = 4;
+  options.buffer_pool.huge_pages = true;
+  options.io_backend = db::io_backend_t::IO_URING;
+  db::Database &db = db::initDatabase(options);
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "direct";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::DIRECT));
+  auto &file = db.get(name);
+  constexpr int size = 53 * 20;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  db.getBufferPool().flushFile(name);
+
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+
+  if (file.getMode() == db::file_mode_t::DIRECT) {
+    db::Page page;
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[db::DEFAULT_PAGE_SIZE + 1]);
+    iovec iov{buffer.get() + 1, db::DEFAULT_PAGE_SIZE};
+    EXPECT_THROW(file.request(false, 0, &iov, 1), std::logic_error);
+    // Unaligned pages go through an aligned copy
+    file.readPage(page, 1);
+    EXPECT_EQ(db::HeapPage(page, file.getTupleDesc()).begin(), 0);
+  }
+}
+
+TEST(IoBackendTest, MemoryMapped) {
+  db::Database &db = db::getDatabase();
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  const char *name = "mapped";
+  std::remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, db::TupleDesc(types, names), db::file_mode_t::MMAP));
+  auto &file = db.get(name);
+  ASSERT_EQ(file.getMode(), db::file_mode_t::MMAP);
+  EXPECT_NE(file.mappedPage(0), nullptr);
+
+  // Writes go through the buffer pool until they are flushed; the file outgrows its first mapping
+  constexpr int size = 53 * 40;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+  EXPECT_EQ(file.mappedPage(0), nullptr);
+  db.getBufferPool().flushFile(name);
+  ASSERT_NE(file.mappedPage(file.getNumPages() - 1), nullptr);
+  EXPECT_EQ(file.mappedPage(file.getNumPages()), nullptr);
+
+  // Scans and lookups read the pages in place
+  size_t reads = file.getReads().size();
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    EXPECT_EQ(std::get<int>(file.getTuple(it).get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+  EXPECT_EQ(file.getReads().size(), reads);
+
+  // A deletion is visible before and after it is flushed
+  file.deleteTuple(file.begin());
+  EXPECT_EQ(std::get<int>(file.getTuple(file.begin()).get_field(0)), 1);
+  db.getBufferPool().flushFile(name);
+  EXPECT_NE(file.mappedPage(0), nullptr);
+  EXPECT_EQ(std::get<int>(file.getTuple(file.begin()).get_field(0)), 1);
+}
@@ -1,5 +1,7 @@
+#include <db/StaticTupleDesc.hpp>
 #include <db/Tuple.hpp>
 #include <gtest/gtest.h>
+#include <memory_resource>
 
 TEST(TupleTest, Constructor) {
   std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
@@ -105,3 +107,200 @@ TEST(TupleTest, MergeConflict) {
 
   EXPECT_ANY_THROW(db::TupleDesc::merge(td1, td2));  // Non-unique names
 }
+
+TEST(TupleTest, View) {
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  db::TupleDesc td(types, names);
+  std::vector<uint8_t> data(td.length() + 1);
+  td.serialize(data.data() + 1, db::Tuple({123, "Hello", 3.14})); // fields need not be aligned
+
+  db::TupleView view(td, data.data() + 1);
+  EXPECT_EQ(view.size(), 3);
+  EXPECT_EQ(view.field_type(1), db::type_t::CHAR);
+  EXPECT_EQ(view.get_int(0), 123);
+  EXPECT_EQ(view.get_char(1), "Hello");
+  EXPECT_EQ(view.get_double(2), 3.14);
+  EXPECT_THROW(view.get_double(0), std::logic_error);
+  EXPECT_THROW(view.get_int(3), std::out_of_range);
+
+  db::Tuple t = view.materialize();
+  EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+
+  // A CHAR field that fills all its bytes has no terminator
+  std::string full(db::CHAR_SIZE, 'x');
+  td.serialize(data.data(), db::Tuple({1, full, 2.0}));
+  EXPECT_EQ(db::TupleView(td, data.data()).get_char(1), full);
+}
+
+TEST(TupleTest, StaticTupleDesc) {
+  using Schema = db::StaticTupleDesc<int, db::Char<>, double>;
+  static_assert(Schema::length == db::INT_SIZE + db::CHAR_SIZE + db::DOUBLE_SIZE);
+  static_assert(Schema::offsets[2] == db::INT_SIZE + db::CHAR_SIZE);
+
+  db::TupleDesc td = Schema::desc({"id", "name", "price"});
+  EXPECT_TRUE(Schema::matches(td));
+  EXPECT_FALSE((db::StaticTupleDesc<int, double>::matches(td)));
+  EXPECT_EQ(td.length(), Schema::length);
+  EXPECT_EQ(td.offset_of(2), Schema::offsets[2]);
+
+  // Tuples written with one are read with the other
+  std::vector<uint8_t> data(Schema::length);
+  Schema::serialize(data.data(), Schema::values{123, "Hello", 3.14});
+  db::Tuple t = td.deserialize(data.data());
+  EXPECT_EQ(std::get<int>(t.get_field(0)), 123);
+  EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+  EXPECT_EQ(std::get<double>(t.get_field(2)), 3.14);
+
+  td.serialize(data.data(), db::Tuple({7, "World", 2.5}));
+  EXPECT_EQ(Schema::get<0>(data.data()), 7);
+  EXPECT_EQ(Schema::get<1>(data.data()), "World");
+  EXPECT_EQ(Schema::read(data.data()), Schema::values(7, "World", 2.5));
+  Schema::set<2>(data.data(), 1.5);
+  EXPECT_EQ(db::TupleView(td, data.data()).get_double(2), 1.5);
+
+  Schema::serialize(data.data(), db::Tuple({8, "Hi", 0.5}));
+  EXPECT_EQ(std::get<std::string>(Schema::deserialize(data.data()).get_field(1)), "Hi");
+  EXPECT_THROW(Schema::serialize(data.data(), db::Tuple({8, 0.5, "Hi"})), std::logic_error);
+  EXPECT_THROW(Schema::serialize(data.data(), db::Tuple({8, "Hi"})), std::logic_error);
+}
+
+TEST(TupleTest, Varchar) {
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::VARCHAR, db::type_t::VARCHAR};
+  std::vector<std::string> names{"id", "first", "last"};
+  db::TupleDesc td(types, names, {0, 10, 20});
+  EXPECT_FALSE(td.fixed_length());
+  EXPECT_TRUE(db::TupleDesc({db::type_t::INT}, {"id"}).fixed_length());
+  EXPECT_EQ(td.length(), db::INT_SIZE + 2 * db::VARCHAR_SIZE);
+  EXPECT_EQ(td.max_chars(1), 10);
+  EXPECT_EQ(db::TupleDesc(types, names).max_chars(2), db::DEFAULT_VARCHAR_LENGTH);
+  EXPECT_ANY_THROW(db::TupleDesc(types, names, {0, 0, 20}));
+  EXPECT_ANY_THROW(db::TupleDesc(types, names, {0, 10}));
+
+  db::Tuple t({1, "Ada", "Lovelace"});
+  EXPECT_TRUE(td.compatible(t));
+  EXPECT_FALSE(td.compatible(db::Tuple({1, "Ada", std::string(21, 'x')})));
+  EXPECT_FALSE(td.compatible(db::Tuple({1, 2, "Lovelace"})));
+  EXPECT_EQ(td.length(t), td.length() + 3 + 8);
+
+  std::vector<uint8_t> data(td.length(t));
+  EXPECT_EQ(td.serialize(data.data(), t), data.size());
+  db::Tuple read = td.deserialize(data.data());
+  EXPECT_EQ(std::get<std::string>(read.get_field(1)), "Ada");
+  EXPECT_EQ(std::get<std::string>(read.get_field(2)), "Lovelace");
+  db::TupleView view(td, data.data());
+  EXPECT_EQ(view.get_int(0), 1);
+  EXPECT_EQ(view.get_char(1), "Ada");
+  EXPECT_EQ(view.get_char(2), "Lovelace");
+
+  db::TupleDesc merged = db::TupleDesc::merge(td, db::TupleDesc({db::type_t::CHAR}, {"name"}));
+  EXPECT_EQ(merged.max_chars(2), 20);
+  EXPECT_EQ(merged.max_chars(3), db::CHAR_SIZE);
+}
+
+TEST(TupleTest, Projection) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::VARCHAR},
+                   {"id", "name", "price", "note"}, {0, 0, 0, 20});
+  std::vector<uint8_t> data(td.length() + 5);
+  td.serialize(data.data(), db::Tuple({7, "seven", 7.5, "hello"}));
+
+  // Only the projected fields are decoded, in the order of the projection
+  db::Projection byIndex(td, std::vector<size_t>{2, 0});
+  EXPECT_EQ(byIndex.getTupleDesc().size(), 2);
+  EXPECT_EQ(byIndex.getTupleDesc().index_of("price"), 0);
+  EXPECT_EQ(byIndex.getTupleDesc().offset_of(1), db::DOUBLE_SIZE);
+  db::Tuple t = byIndex.deserialize(data.data());
+  EXPECT_EQ(t.size(), 2);
+  EXPECT_EQ(std::get<double>(t.get_field(0)), 7.5);
+  EXPECT_EQ(std::get<int>(t.get_field(1)), 7);
+
+  db::Projection byName(td, std::vector<std::string>{"note", "name"});
+  EXPECT_EQ(byName.getFields(), std::vector<size_t>({3, 1}));
+  EXPECT_EQ(byName.getTupleDesc().max_chars(0), 20);
+  t = byName.deserialize(data.data());
+  EXPECT_EQ(std::get<std::string>(t.get_field(0)), "hello");
+  EXPECT_EQ(std::get<std::string>(t.get_field(1)), "seven");
+  t = byName.materialize(db::TupleView(td, data.data()));
+  EXPECT_EQ(std::get<std::string>(t.get_field(0)), "hello");
+
+  EXPECT_THROW(db::Projection(td, std::vector<size_t>{4}), std::out_of_range);
+  EXPECT_THROW(db::Projection(td, std::vector<size_t>{1, 1}), std::logic_error);
+  EXPECT_THROW(db::Projection(td, std::vector<std::string>{"missing"}), std::logic_error);
+}
+
+TEST(TupleTest, FlatTuple) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::VARCHAR, db::type_t::CHAR, db::type_t::VARCHAR, db::type_t::DOUBLE},
+                   {"id", "first", "city", "last", "score"}, {0, 10, 0, 20, 0});
+  db::Tuple t({1, "Ada", "London", "Lovelace", 0.5});
+  db::FlatTuple flat(td, t);
+  EXPECT_EQ(flat.size(), 5);
+  EXPECT_EQ(flat.field_type(2), db::type_t::CHAR);
+  EXPECT_EQ(flat.get_int(0), 1);
+  EXPECT_EQ(flat.get_char(1), "Ada");
+  EXPECT_EQ(flat.get_char(2), "London");
+  EXPECT_EQ(flat.get_char(3), "Lovelace");
+  EXPECT_EQ(flat.get_double(4), 0.5);
+  EXPECT_EQ(flat.materialize(), t);
+
+  // The characters of the later VARCHAR fields move when a VARCHAR field changes length
+  flat.set_char(1, "Augusta Ad");
+  EXPECT_EQ(flat.get_char(1), "Augusta Ad");
+  EXPECT_EQ(flat.get_char(3), "Lovelace");
+  flat.set_char(1, "Augusta");
+  flat.set_char(3, "King");
+  flat.set_char(2, std::string(db::CHAR_SIZE + 5, 'x'));
+  flat.set_int(0, 2);
+  flat.set_double(4, 1.5);
+  db::Tuple expected({2, "Augusta", std::string(db::CHAR_SIZE, 'x'), "King", 1.5});
+  EXPECT_EQ(flat.materialize(), expected);
+  std::vector<uint8_t> data(td.length(expected));
+  td.serialize(data.data(), expected);
+  EXPECT_EQ(std::vector<uint8_t>(flat.bytes(), flat.bytes() + data.size()), data);
+  EXPECT_EQ(flat.view().length(), data.size());
+
+  EXPECT_THROW(flat.set_int(4, 1), std::logic_error);
+  EXPECT_THROW(flat.set_double(0, 1), std::logic_error);
+  EXPECT_THROW(flat.set_char(0, "1"), std::logic_error);
+  EXPECT_THROW(flat.set_char(3, std::string(21, 'x')), std::logic_error);
+  EXPECT_THROW(flat.set_int(5, 1), std::out_of_range);
+  EXPECT_THROW(db::FlatTuple(td, db::Tuple({1, "Ada"})), std::logic_error);
+
+  db::FlatTuple copy(db::TupleView(td, data.data()));
+  EXPECT_EQ(copy.materialize(), expected);
+  db::FlatTuple moved(std::move(copy));
+  EXPECT_EQ(moved.get_char(3), "King");
+}
+
+TEST(TupleTest, FlatTupleAllocator) {
+  // Counts the allocations that reach the upstream resource
+  struct Counting : std::pmr::memory_resource {
+    size_t allocations = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+      allocations++;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+  };
+
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::VARCHAR}, {"id", "name", "note"}, {0, 0, 16});
+  constexpr size_t n = 1000;
+  Counting upstream;
+  {
+    std::pmr::monotonic_buffer_resource arena(n * 128, &upstream);
+    std::pmr::vector<db::FlatTuple> tuples(&arena);
+    tuples.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      // uses-allocator construction: the buffer of each tuple comes from the arena
+      tuples.emplace_back(td, db::Tuple({static_cast<int>(i), "name", std::to_string(i)}));
+    }
+    EXPECT_EQ(tuples[n - 1].get_char(2), std::to_string(n - 1));
+    EXPECT_EQ(tuples[0].get_allocator().resource(), &arena);
+  }
+  EXPECT_EQ(upstream.allocations, 1);
+}